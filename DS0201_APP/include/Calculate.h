@@ -18,6 +18,24 @@ void            Int32String(I32STR_RES * r, unsigned int n, unsigned char e);
 void            Char_to_Str(unsigned char *p, unsigned char n);
 void            PercentString(I32STR_RES * r, short n);
 unsigned short  sqrt32(unsigned long n);
+unsigned int    sqrt64(unsigned long long n);
+
+// FFT bin magnitude, MAG_EXACT 1: integer square root, 0: alpha max + beta min
+#define MAG_EXACT       1
+
+unsigned int    Magnitude(int x, int y);
+unsigned int    Log2(unsigned int n);
+
+// sample run kernels, samples are 12 bit ADC values
+// SAMPLE_SWAR 1: two samples per 32 bit word, 0: portable one sample at a time
+#ifndef SAMPLE_SWAR
+#define SAMPLE_SWAR     1
+#endif
+
+unsigned int    Sum_Samples(const volatile unsigned short *p, unsigned short n);
+void            MinMax_Samples(const volatile unsigned short *p, unsigned short n, unsigned short *min, unsigned short *max);
+unsigned short  Count_Below(const volatile unsigned short *p, unsigned short n, unsigned int t);
+unsigned long long Sum_Squares(const volatile unsigned short *p, unsigned short n, unsigned int t, unsigned int *a);
 
 #endif
 /********************************* END OF FILE ********************************/
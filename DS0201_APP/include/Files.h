@@ -3,6 +3,8 @@
  *******************************************************************************/
 #ifndef __FILES_H
 #define __FILES_H
+extern unsigned int File_Size;
+
 //==================== Function declarations ===================================
 char            FAT_Info(void);
 char            Open_File(unsigned const char *name, unsigned char *num, unsigned const char *ext);
@@ -13,6 +15,7 @@ unsigned char   DirMatch(unsigned const char *p1, unsigned const char *p2, unsig
 
 char            Read_File(void);
 char            Write_File(void);
+char            Next_Sector(void);
 char            Writ_BMP_File(void);
 void            Read_Parameter(void);
 char            Write_Parameter(void);
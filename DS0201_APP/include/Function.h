@@ -11,6 +11,110 @@
 #define HOLD               1
 #define RISING             0
 
+#define MEASURE_REFRESH  200    // minimum interval between measurement repaints, ms
+#define RATE_TIME       1000    // ms the waveform update rate is counted over, at least
+#define NO_MEASURE        -1    // pulse measurement not found in the record
+#define NO_VALUE  ((int)0x80000000)  // Measure_Value: kind not given by the record
+#define N_STAT_WINDOW      5    // choices of Item_Index[MEASURE_STATS]
+#define FFT_MAX         1024    // largest complex FFT, points, sizes the scratch arena
+#define FFT_PART         256    // largest complex FFT run whole, FFT_MAX goes as four
+#define N_FFT_SIZE         3    // choices of Item_Index[FFT_SIZE]
+#define N_FFT_WINDOW       5    // choices of Item_Index[FFT_WINDOW]
+#define N_FFT_SCALE        5    // choices of Item_Index[FFT_SCALE]
+#define FFT_DBV            4    // Item_Index[FFT_SCALE]: dBV at 10 dB/div, the top on a 10 dB step
+#define N_FFT_AVG          5    // choices of Item_Index[FFT_AVG]
+#define N_FFT_ZOOM         5    // choices of Item_Index[FFT_ZOOM], off and x2 .. x16
+#define FFT_CENTER_FS   8192    // Item_Index[FFT_CENTER] steps per sample rate
+#define ZOOM_TAPS         16    // zoom low pass taps per decimation step
+#define ZOOM_DEC_MAX      11    // largest zoom decimation
+#define N_FFT_HARM         4    // choices of Item_Index[FFT_HARM], the view
+#define FFT_VIEW_HARM      1    // Item_Index[FFT_HARM]: harmonic bars
+#define FFT_VIEW_TONE      2    // tone detector bars instead of the FFT
+#define FFT_VIEW_OFF       3    // neither
+#define N_TONE_SET         4    // choices of Item_Index[TONE_SET]
+#define N_TONE             8    // tones per set
+#define N_TONE_PICK  (N_TONE + 1)  // choices of Item_Index[TONE_PICK], strongest and each tone
+
+// reciprocal frequency counter, TIM2_CH1 input capture on PA0 (Ain)
+#define CNT_IDLE           0    // counter off
+#define CNT_ARM            1    // waiting for the edge that opens the gate
+#define CNT_GATE           2    // counting edges until the gate time has passed
+#define CNT_DONE           3    // gate closed, result pending
+#define CNT_TIMEOUT     1000    // ms to wait for an edge beyond the gate time
+#define CNT_FAST    20000000    // mHz, capture every 8th edge above this
+#define CNT_MAX   3999999999U   // largest reading Int32String rounds to 6 digits
+
+typedef struct _CounterType {
+  unsigned char  State;
+  unsigned char  Psc;     // periods per capture, log2 (TIM2 IC1PSC)
+  unsigned char  Over;    // a capture was overwritten before it was read
+  unsigned short Gate;    // gate time, ms
+  unsigned short Time;    // ms since armed, or since the gate opened
+  unsigned int   Wrap;    // TIM2 period in 72MHz ticks, TIM2_ARR + 1 at the start
+  unsigned int   Ovf;     // TIM2 overflows, upper part of the timestamps
+  unsigned int   Edges;   // captures since the gate opened
+  unsigned int   First;   // 72MHz timestamp of the capture that opened the gate
+  unsigned int   Last;    // 72MHz timestamp of the latest capture
+} CounterType;
+
+// running statistics of one measure kind, Welford's update with the weight
+// 1/n held at 1/window once n reaches the window. The window is exponential,
+// about the last N records with older ones fading, no values are kept; Min
+// and Max always cover everything since the last reset
+typedef struct _StatType {
+  long long      Mean;    // 1/65536 unit
+  long long      Var;     // population variance, 1/256 unit^2
+  int            Min, Max;
+  int            Rem;     // remainder of the last Var step, carried to the next
+  int            MRem;    // and of the last Mean step
+  unsigned short Count;   // values since the last reset, saturates
+} StatType;
+
+// one resonator of the tone detector
+typedef struct _ToneType {
+  unsigned int   W;       // phase step per sample, 2^32 per period, 0: out of the band
+  int            C;       // 2 cos(w), 1.0 = 2^29
+  int            Sin;     // sin(w), 1.0 = 32768
+  int            S1, S2;  // resonator state
+  unsigned int   Rms;     // level, 1/256 ADC step
+  unsigned short Bar;     // bar height as a bin magnitude
+} ToneType;
+
+// transient work memory, shared by F_Buff during a file operation, the pulse
+// histogram in Measure_Wave, the FFT arrays and the tone resonators. The FFT
+// and tone members stay live from FFT_Window over the FFT_Step passes that
+// follow, FFT_Finish completes the frame before any other member is taken.
+// The zoom mixer and the tone detector keep a 12 bit copy of the record,
+// the next capture refills Scan_Buffer while they run. The mixer fills
+// Fft.In from the copy at the top of Zoom.Rec, behind the samples it reads,
+// and keeps its filter in the part of Fft.Out the FFT has not written yet.
+// The largest FFT runs as four FFT_PART point transforms through Fft.Out,
+// each copied back over its input
+typedef union _ScratchType {
+  unsigned char    File[512];
+  struct {
+    unsigned short Hist[64];    // record samples per 64 code bin
+    unsigned int   HSum[64];    // and their sum, for the top and base level
+  } Pulse;
+  struct {
+    int            In[FFT_MAX];   // two real samples per word, even one in the lower half
+    int            Out[FFT_PART]; // spectrum, the bin magnitudes go to In
+  } Fft;
+  struct {
+    // the record at 12 bit at the top, the mixer output fills Fft.In from the bottom
+    unsigned char  Rec[4 * (FFT_MAX + FFT_PART - 2 * ZOOM_TAPS) - 2 * ZOOM_TAPS * ZOOM_DEC_MAX];
+    int            Acc[2 * ZOOM_TAPS];  // I and Q sums of the outputs in progress
+    short          Coef[ZOOM_TAPS * ZOOM_DEC_MAX];  // low pass, 1.0 = 32768
+  } Zoom;
+  struct {
+    ToneType       R[N_TONE];
+    unsigned char  Rec[BUFFER_SIZE * 3 / 2];  // the record, two samples in three bytes
+  } Tones;
+} ScratchType;
+
+#define F_Buff  Scratch.File
+
+extern ScratchType   Scratch;
 extern volatile unsigned short Scan_Buffer[BUFFER_SIZE];
 extern unsigned char View_Buffer[300], Erase_Buffer[300], Ref_Buffer[304];
 extern unsigned char Signal_Buffer[300];
@@ -20,7 +124,19 @@ extern unsigned char Sync;
 extern unsigned char SyncSegment;
 
 extern unsigned char MeFr, MeDC;
-extern int           Frequency, Duty, Vpp, Vrms, Vavg, Vdc, Vmin, Vmax;
+extern int           Frequency, Duty, Vpp, Vrms, Vavg, Vdc, Vmin, Vmax, Vtone;
+extern int           Rise, Fall, PWidth, NWidth, Period, Overshoot, Preshoot, Thd, ThdN, Rate;
+extern volatile unsigned short Rate_Time;
+
+extern StatType      Stat[];
+extern unsigned const short Stat_Window[N_STAT_WINDOW];
+
+extern volatile CounterType Counter;
+extern unsigned int  Counter_Freq, Counter_Period;
+extern unsigned char Counter_TUnit;
+extern unsigned const short Gate_Time[4];
+extern unsigned const short FFT_Size[N_FFT_SIZE];
+extern short         FFT_Top;
 
 int AdcToSig(int adc);
 int SigToAdc(int sig);
@@ -36,6 +152,18 @@ void            Erase_Wave(unsigned short t1, unsigned short t2);
 void            Redraw_Wave(void);
 void            Draw_Wave(void);
 void            Measure_Wave(void);
+int             Measure_Value(unsigned char k);
+void            Stat_Reset(void);
+void            FFT_Step(void);
+void            FFT_Finish(void);
+void            Erase_FFT(void);
+void            FFT_Avg_Reset(void);
+void            FFT_Move_Center(int s);
+void            Counter_Capture(unsigned int sr, unsigned int ccr);
+void            Counter_Tick(void);
+unsigned char   Counter_Calc(void);
+void            Counter_Start(unsigned char g);
+void            Counter_Poll(void);
 
 #endif
 /******************************** END OF FILE *********************************/
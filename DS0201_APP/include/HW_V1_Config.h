@@ -21,10 +21,12 @@
 #define TIM2_CR1    (*((vu32 *)(TIM2_BASE+0x00)))
 #define TIM2_DIER   (*((vu32 *)(TIM2_BASE+0x0C)))
 #define TIM2_SR     (*((vu32 *)(TIM2_BASE+0x10)))
+#define TIM2_CCMR1  (*((vu32 *)(TIM2_BASE+0x18)))
 #define TIM2_CCMR2  (*((vu32 *)(TIM2_BASE+0x1C)))
 #define TIM2_CCER   (*((vu32 *)(TIM2_BASE+0x20)))
 #define TIM2_PSC    (*((vu32 *)(TIM2_BASE+0x28)))
 #define TIM2_ARR    (*((vu32 *)(TIM2_BASE+0x2C)))
+#define TIM2_CCR1   (*((vu32 *)(TIM2_BASE+0x34)))
 #define TIM2_CCR4   (*((vu32 *)(TIM2_BASE+0x40)))
 
 #define TIM3_CR1    (*((vu32 *)(TIM3_BASE+0x00)))
@@ -171,6 +173,7 @@ extern LIB_Interface *pLib;
 
 extern volatile unsigned short Delay_Counter;
 extern volatile unsigned short Refresh_Counter;
+extern volatile unsigned short Measure_Counter;
 extern volatile unsigned char Key_Buffer;
 
 #endif
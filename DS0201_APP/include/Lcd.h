@@ -55,6 +55,10 @@
 #define ADD		0 //add
 #define ERASE		1 //erase
 
+#define FONT_FIRST	0x22 // first glyph in the LIB font table
+#define FONT_LAST	0x7E // last glyph used by the APP
+#define FONT_WORDS	((FONT_LAST - FONT_FIRST + 1) * 8)  // glyph cache, halfwords
+
 extern unsigned const int Logo_Dot[512];
 
 //===================== fuction declarations ===================================
@@ -63,8 +67,10 @@ void LCD_SET_WINDOW(short x1, short x2,short y1, short y2);
 void Point_SCR(unsigned short x0, unsigned short y0);
 void Set_Pixel(unsigned short Color);
 void Clear_Screen(unsigned short Color);
+void Init_Font(void);
 void Display_Frame(void);
 void Display_Grid(void);
+void Display_Grid_Area(short x0, short y0, short width, short height);
 
 void Fill_Rectangle(short x0, short y0, short width, short height, short Color);
 void Rounded_Rectangle(short x0, short y0, short width, short height, short Color);
@@ -72,6 +78,7 @@ void Display_Info(unsigned short x0, unsigned short y0, char *Pre, long Num);
 void Display_Str(short x0, short y0, short Color, char Mode, unsigned const char *s);
 void Erase_SEG(unsigned short x, unsigned short y1, unsigned short y2, unsigned short Color);
 void Draw_SEG(unsigned short x, unsigned short y1, unsigned short y2, unsigned short Color);
+void Popup_SEG(unsigned short x, unsigned short y1, unsigned short y2, unsigned short Color);
 void Draw_Trig_Pos(void);
 void Erase_Trig_Pos(void);
 
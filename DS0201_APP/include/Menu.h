@@ -42,6 +42,18 @@
 #define LOAD_PROFILE      24
 #define CALIBRATE_OFFSET  25
 #define CALIBRATE_RANGE   26
+#define COUNTER_GATE      27
+#define MEASURE_STATS     28
+#define MEASURE_GATE      29
+#define FFT_SIZE          30
+#define FFT_WINDOW        31
+#define FFT_SCALE         32
+#define FFT_AVG           33
+#define FFT_ZOOM          34
+#define FFT_CENTER        35
+#define FFT_HARM          36
+#define TONE_SET          37
+#define TONE_PICK         38
 
 // item/hide index
 #define REF                1    // reference wave
@@ -56,6 +68,15 @@
 #define VT                19    // Y axis trigger level
 
 #define N_MENU (sizeof(Menu) / sizeof(Menu[0]))
+#define MENU_PITCH 17 // label rows of the right column, 11 labels stay clear of the top fields
+#define N_MEASURE 19  // measure kinds, range of Item_Index[MEASURE_KIND]
+#define N_FIELD (10 + N_MEASURE)  // status fields, then one cell per measure kind
+#define N_ITEM  39    // entries in Item_Index/Hide_Index, one Update bit each, 64 at most
+
+// Update[x] is the SRAM bit-band alias of bit x in Update_Mask, so setting or
+// clearing one flag is a single atomic store, safe against the TIM3 interrupt.
+// The alias runs on from word 0 into word 1, bit x is bit x % 32 of word x / 32
+#define Update ((volatile u32 *)(SRAM_BB_BASE + (((u32)Update_Mask - SRAM_BASE) << 5)))
 #define N_SUB (sizeof(Sub) / sizeof(Sub[0]))
 
 typedef struct _SubMenuType {
@@ -79,12 +100,13 @@ typedef struct _FieldType {
 typedef struct _PopupType {
   short x;              // x-position, pixels
   short y;              // y-position pixels
-  unsigned char width;  // pixel width
+  unsigned short width; // pixel width
   unsigned char height; // pixel height
+  unsigned char lx;     // x-offset of the sub option list, the statistics panel is left of it
   unsigned char Sub;    // index of highlighted sub option
   unsigned char Sub1;   // index of first sub option
   unsigned char Sub2;   // index of last sub option
-  unsigned char Active; // set to 1 when popup is active
+  unsigned char Active; // 1 when the sub menu popup is shown, 2 for the measure table
 } PopupType;
 
 extern MainMenuType Menu[];
@@ -95,16 +117,15 @@ extern unsigned char CurrentMenu;
 
 extern unsigned const char Item_V[20][10], Item_T[22][10];
 extern unsigned const int V_Scale[20], T_Scale[22], Fout_ARR[16];
-extern unsigned const char V_Unit[4][3], T_Unit[4][3];
+extern unsigned const char V_Unit[4][3], T_Unit[4][3], C_Unit[4][4];
 extern unsigned const short Scan_PSC[22], Scan_ARR[22];
 extern unsigned short Y_POSm[20], Km[20];
 extern short    Y_POSn[20];
 extern unsigned short Tp;
-extern unsigned char F_Buff[512];
 extern unsigned char FileNum[4];
-extern volatile unsigned char Update[27];
-extern unsigned short Item_Index[27];
-extern unsigned char Hide_Index[27];
+extern volatile unsigned int Update_Mask[2];
+extern unsigned short Item_Index[N_ITEM];
+extern unsigned char Hide_Index[N_ITEM];
 
 void Update_Item(void);
 void Erase_Sensitivity(void);
@@ -115,6 +136,9 @@ void SelectMenu(unsigned char NewMenu);
 void SelectSub(unsigned char pi);
 unsigned char CheckSub(unsigned char SubOrg, unsigned char SubNew);
 void RefreshMeasure(void);
+void RefreshStat(unsigned char k);
+void ShowTable(void);
+void RefreshTable(void);
 void DisplayFieldEx(unsigned char fi, unsigned short Color, unsigned const char *pre, unsigned const char *str, unsigned const char *suf);
 void DisplayField(unsigned char fi, unsigned short Color, unsigned const char *str);
 
@@ -4,17 +4,81 @@ File Name: Calculate.c
 
 #include "Calculate.h"
 
+#if defined(__IAR_SYSTEMS_ICC__)
+# include <intrinsics.h>
+# define CLZ(x) __CLZ(x)
+#else
+# define CLZ(x) __builtin_clz(x)
+#endif
+
+static unsigned const int Pow10[10] = {
+   1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+
+static const char Digit2[201] =
+   "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+   "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+   "8081828384858687888990919293949596979899";
+
+/*******************************************************************************
+ Function Name : Digit_Count
+ Description : number of decimal digits of n less one (0 for 0). The bit length
+               times log10(2) (1233 / 4096) is the count or one too many
+*******************************************************************************/
+static unsigned char Digit_Count(unsigned int n)
+{
+   unsigned int i = ((32 - CLZ(n | 1)) * 1233) >> 12;
+
+   return i - (i && (n < Pow10[i]));
+}
+
+/*******************************************************************************
+ Function Name : Digit_String
+ Description : write n rounded to e significant digits right aligned in w
+               characters, led by sign if it is not 0. A '.' follows the
+               digit of the highest power of 1000 if more digits follow
+ NOTE : digits come two at a time from Digit2[], n / 100 is the reciprocal
+        multiply n * (2^37 / 100) >> 37, exact for all 32 bit n
+*******************************************************************************/
+static void Digit_String(I32STR_RES * r, unsigned int n, unsigned char e, char sign, unsigned char w)
+{
+   char           d[10], *p = r->str;
+   unsigned int   q, t;
+   unsigned char  i, j, k, dp;
+
+   i = Digit_Count(n);
+   if (i >= e) {                   // round half up at the last shown digit
+      n += 5 * Pow10[i - e];
+      i = Digit_Count(n);
+   }
+   for (j = 0; j <= i; j += 2) {   // d[j] is the digit of 10^j
+      q = ((unsigned long long)n * 0x51EB851F) >> 37;
+      t = (n - q * 100) * 2;
+      d[j] = Digit2[t + 1];
+      d[j + 1] = Digit2[t];
+      n = q;
+   }
+   r->decPos = i / 3;
+   k = ((e != 0) && (e <= i)) ? e : i + 1;
+   dp = r->decPos * 3;
+   j = (sign != 0) + k + ((dp != 0) && (dp + k > i + 1));
+   for (; j < w; j++) *p++ = ' ';
+   if (sign) *p++ = sign;
+   for (j = i + 1; k; k--) {
+      *p++ = d[--j];
+      if ((j == dp) && (k > 1) && dp) *p++ = '.';
+   }
+   *p = 0;
+   r->len = p - r->str;
+}
+
 /*******************************************************************************
  Function Name : Int32String_sign
  Description : convert signed 32 bit number to string
 *******************************************************************************/
 void Int32String_sign(I32STR_RES * r, int n, unsigned char e)
 {
-   unsigned int   m, c;
-   unsigned char  i, fixlen;
-   char           *p = r->str;
+   char *p = r->str;
 
-   fixlen = e + 2;
    if (n == 0)
    {
       *p++ = ' ';
@@ -28,97 +92,9 @@ void Int32String_sign(I32STR_RES * r, int n, unsigned char e)
       return;
    }
    if (n > 0)
-      *p++ = ' ';
+      Digit_String(r, n, e, ' ', e + 2);
    else
-   {
-      *p++ = '-';
-      n = -n;
-   }
-   m = n;
-   i = 0;
-   c = 5;
-   while (m >= 10)
-   {
-      m /= 10;
-      if (++i > e)
-         c *= 10;
-   }
-   if (i >= e) {
-      n += c;
-      m = n;
-      i = 0;
-      while (m >= 10) m /= 10, i++;
-   }
-   r->decPos = i / 3;
-   switch (i)
-   {
-   case 9:
-      *p++ = '0' + n / 1000000000;
-      if (--e == 0)
-         break;
-      n %= 1000000000;
-      *p++ = '.', i = 0;
-   case 8:
-      *p++ = '0' + n / 100000000;
-      if (--e == 0)
-         break;
-      n %= 100000000;
-   case 7:
-      *p++ = '0' + n / 10000000;
-      if (--e == 0)
-         break;
-      n %= 10000000;
-   case 6:
-      *p++ = '0' + n / 1000000;
-      if (--e == 0)
-         break;
-      n %= 1000000;
-      if (i)
-         *p++ = '.', i = 0;
-   case 5:
-      *p++ = '0' + n / 100000;
-      if (--e == 0)
-         break;
-      n %= 100000;
-   case 4:
-      *p++ = '0' + n / 10000;
-      if (--e == 0)
-         break;
-      n %= 10000;
-   case 3:
-      *p++ = '0' + n / 1000;
-      if (--e == 0)
-         break;
-      n %= 1000;
-      if (i)
-         *p++ = '.', i = 0;
-   case 2:
-      *p++ = '0' + n / 100;
-      if (--e == 0)
-         break;
-      n %= 100;
-   case 1:
-      *p++ = '0' + n / 10;
-      if (--e == 0)
-         break;
-      n %= 10;
-   case 0:
-      *p++ = '0' + n;
-   }
-
-   while (p < r->str + fixlen) {
-     char *q = p;
-     while (q > r->str) {
-       *q = *(q - 1);
-       q--;
-     }
-     *q = ' ';
-     p++;
-   }
-//   while (p < r->str + fixlen)
-//      *p++ = ' ';
-   *p = 0;
-   r->len = p - r->str;
+      Digit_String(r, 0 - (unsigned int)n, e, '-', e + 2);
 }
 
 /*******************************************************************************
@@ -148,11 +124,8 @@ void PercentString(I32STR_RES * r, short n)
 *******************************************************************************/
 void Int32String(I32STR_RES * r, unsigned int n, unsigned char e)
 {
-   unsigned int   m, c;
-   unsigned char  i, fixlen;
-   char           *p = r->str;
+   char *p = r->str;
 
-   fixlen = e + 1;
    if (n == 0)
    {
       *p++ = '0';
@@ -165,90 +138,7 @@ void Int32String(I32STR_RES * r, unsigned int n, unsigned char e)
       r->len = p - r->str;
       return;
    }
-   m = n;
-   i = 0;
-   c = 5;
-   while (m >= 10)
-   {
-      m /= 10;
-      if (++i > e)
-         c *= 10;
-   }
-   if (i >= e) {
-      n += c;
-      m = n;
-      i = 0;
-      while (m >= 10) m /= 10, i++;
-   }
-   r->decPos = i / 3;
-   switch (i)
-   {
-   case 9:
-      *p++ = '0' + n / 1000000000;
-      if (--e == 0)
-         break;
-      n %= 1000000000;
-      *p++ = '.', i = 0;
-   case 8:
-      *p++ = '0' + n / 100000000;
-      if (--e == 0)
-         break;
-      n %= 100000000;
-   case 7:
-      *p++ = '0' + n / 10000000;
-      if (--e == 0)
-         break;
-      n %= 10000000;
-   case 6:
-      *p++ = '0' + n / 1000000;
-      if (--e == 0)
-         break;
-      n %= 1000000;
-      if (i)
-         *p++ = '.', i = 0;
-   case 5:
-      *p++ = '0' + n / 100000;
-      if (--e == 0)
-         break;
-      n %= 100000;
-   case 4:
-      *p++ = '0' + n / 10000;
-      if (--e == 0)
-         break;
-      n %= 10000;
-   case 3:
-      *p++ = '0' + n / 1000;
-      if (--e == 0)
-         break;
-      n %= 1000;
-      if (i)
-         *p++ = '.', i = 0;
-   case 2:
-      *p++ = '0' + n / 100;
-      if (--e == 0)
-         break;
-      n %= 100;
-   case 1:
-      *p++ = '0' + n / 10;
-      if (--e == 0)
-         break;
-      n %= 10;
-   case 0:
-      *p++ = '0' + n;
-   }
-   while (p < r->str + fixlen) {
-     char *q = p;
-     while (q > r->str) {
-       *q = *(q - 1);
-       q--;
-     }
-     *q = ' ';
-     p++;
-   }
-//   while (p < r->str + fixlen)
-//      *p++ = ' ';
-   *p = 0;
-   r->len = p - r->str;
+   Digit_String(r, n, e, 0, e + 1);
 }
 
 /*******************************************************************************
@@ -265,21 +155,226 @@ void Char_to_Str(unsigned char *p, unsigned char n)
 }
 
 /*******************************************************************************
-  Calculate square root of unsigned long
-********************************************************************************/
+ Function Name : sqrt32
+ Description : floor of the square root of a 32 bit number. n is normalised
+               by CLZ to [2^30, 2^32), its top 6 bits pick a seed within 0.8%,
+               one Newton step brings it to at most 4 above the result and
+               a short count down makes it exact
+*******************************************************************************/
+static unsigned const short Sqrt_Seed[48] = {    // sqrt of (16..63 + 1/2) * 2^26
+   33268, 34263, 35229, 36169, 37085, 37980, 38853, 39708,
+   40544, 41364, 42167, 42956, 43730, 44491, 45239, 45975,
+   46699, 47412, 48115, 48807, 49490, 50163, 50828, 51484,
+   52132, 52771, 53403, 54028, 54646, 55256, 55860, 56458,
+   57049, 57634, 58214, 58787, 59355, 59918, 60475, 61028,
+   61575, 62118, 62656, 63189, 63718, 64242, 64762, 65278
+};
+
 unsigned short sqrt32(unsigned long n)
 {
-    unsigned short c = 0x8000;
-    unsigned short g = 0x8000;
+    unsigned int x, z;
+
+    if (n < 2) return n;
+    z = CLZ(n) & ~1;                               // even, sqrt scales by z / 2
+    x = Sqrt_Seed[(((unsigned int)n << z) >> 26) - 16] >> (z / 2);
+    x = (x + n / x) >> 1;                          // >= the result
+    if (x > 0xffff) x = 0xffff;
+    while (x * x > n) x--;
+    return x;
+}
+
+/*******************************************************************************
+ Function Name : sqrt64
+ Description : floor of the square root of a 64 bit number, sqrt32 of the top
+               32 bits (shifted by an even count) seeds one Newton step
+*******************************************************************************/
+unsigned int sqrt64(unsigned long long n)
+{
+    unsigned long long x;
+    unsigned int s;
+
+    if ((n >> 32) == 0) return sqrt32(n);
+    s = (32 - CLZ(n >> 32) + 1) & ~1;              // n >> s fits 32 bit
+    x = (unsigned long long)(sqrt32(n >> s) + 1) << (s / 2);
+    x = (x + n / x) >> 1;
+    if (x > 0xffffffff) x = 0xffffffff;
+    while (x * x > n) x--;
+    return x;
+}
+
+/*******************************************************************************
+ Function Name : Magnitude
+ Description : magnitude of the complex number x + jy, x, y 16 bit signed.
+               MAG_EXACT 0 uses alpha max + beta min with alpha = 123/128,
+               beta = 51/128, within 4.1% of the exact value above 1024
+*******************************************************************************/
+unsigned int Magnitude(int x, int y)
+{
+    if (x < 0) x = -x;
+    if (y < 0) y = -y;
+#if MAG_EXACT
+    return sqrt32((unsigned int)(x * x) + (unsigned int)(y * y));
+#else
+    return (x > y) ? (x * 123 + y * 51) >> 7 : (y * 123 + x * 51) >> 7;
+#endif
+}
+
+/*******************************************************************************
+ Function Name : Log2
+ Description : base 2 logarithm of n > 0, 1.0 = 4096. CLZ gives the integer
+               part, the top 5 bits of the mantissa pick a table entry and the
+               next 11 bits interpolate, within 0.0004 of the exact value
+*******************************************************************************/
+static unsigned const short Log2_Table[33] = {    // log2(1 + i / 32) * 4096
+      0,  182,  358,  530,  696,  858, 1016, 1169,
+   1319, 1465, 1607, 1746, 1882, 2015, 2145, 2272,
+   2396, 2518, 2637, 2754, 2869, 2982, 3092, 3200,
+   3307, 3412, 3514, 3615, 3715, 3812, 3908, 4003,
+   4096
+};
+
+unsigned int Log2(unsigned int n)
+{
+    unsigned int e, f, i;
 
-    for(;;) {
-      if(g*g > n)
-      g ^= c;
-      c >>= 1;
-      if(c == 0)
-      return g;
-      g |= c;
-    }
+    if (n == 0) return 0;
+    e = 31 - CLZ(n);
+    f = (n << (31 - e)) >> 15;                     // mantissa, 1.0 = 65536
+    i = (f >> 11) & 31;
+    f &= 0x7ff;
+    return (e << 12) + Log2_Table[i] + (((Log2_Table[i + 1] - Log2_Table[i]) * f + 0x400) >> 11);
 }
 
+/*******************************************************************************
+ Function Name : Sum_Samples
+ Description : sum of n samples
+ NOTE : SWAR adds both 16 bit halves of a word at once, a half can take 16
+        12 bit samples before it has to be folded into the total
+*******************************************************************************/
+unsigned int Sum_Samples(const volatile unsigned short *p, unsigned short n)
+{
+   unsigned int s = 0;
+#if SAMPLE_SWAR
+   const volatile unsigned int *w;
+   unsigned int a;
+   unsigned char c;
+
+   if (n && ((unsigned int)p & 2)) { s = *p++; n--; }  // word align
+   w = (const volatile unsigned int *)p;
+   while (n >= 2) {
+      a = 0;
+      for (c = 16; c && (n >= 2); c--, n -= 2) a += *w++;
+      s += (a & 0xFFFF) + (a >> 16);
+   }
+   if (n) s += *(const volatile unsigned short *)w;
+#else
+   while (n--) s += *p++;
+#endif
+   return s;
+}
+/*******************************************************************************
+ Function Name : MinMax_Samples
+ Description : lower *min and raise *max with n samples
+ NOTE : SWAR compares both halves of a word by subtracting with a guard bit
+        above each half, the guard bits left standing mark the halves a >= b
+*******************************************************************************/
+void MinMax_Samples(const volatile unsigned short *p, unsigned short n, unsigned short *min, unsigned short *max)
+{
+   unsigned short lo = *min, hi = *max;
+#if SAMPLE_SWAR
+   const volatile unsigned int *w;
+   unsigned int a, b, l, h, m;
+
+   if (n && ((unsigned int)p & 2)) {  // word align
+     if (*p < lo) lo = *p;
+     if (*p > hi) hi = *p;
+     p++; n--;
+   }
+   w = (const volatile unsigned int *)p;
+   if (n >= 2) {
+      l = *w++;
+      h = l;
+      for (n -= 2; n >= 2; n -= 2) {
+         a = *w++;
+         m = ((((a | 0x80008000) - l) >> 15) & 0x00010001) * 0x7FFF;  // halves a >= l
+         l ^= (a ^ l) & ~m;
+         m = ((((a | 0x80008000) - h) >> 15) & 0x00010001) * 0x7FFF;  // halves a >= h
+         h ^= (a ^ h) & m;
+      }
+      b = l & 0xFFFF; if (b < lo) lo = b;
+      b = l >> 16;    if (b < lo) lo = b;
+      b = h & 0xFFFF; if (b > hi) hi = b;
+      b = h >> 16;    if (b > hi) hi = b;
+   }
+   p = (const volatile unsigned short *)w;
+#endif
+   while (n--) {
+     if (*p < lo) lo = *p;
+     if (*p > hi) hi = *p;
+     p++;
+   }
+   *min = lo;
+   *max = hi;
+}
+/*******************************************************************************
+ Function Name : Count_Below
+ Description : number of samples < t
+ NOTE : SWAR subtracts both halves of a word from t - 1 with a guard bit
+        above each half, a guard bit stays set where the sample is < t
+*******************************************************************************/
+unsigned short Count_Below(const volatile unsigned short *p, unsigned short n, unsigned int t)
+{
+   unsigned short c = 0;
+#if SAMPLE_SWAR
+   const volatile unsigned int *w;
+   unsigned int m, a = 0;
+
+   if (t == 0) return 0;
+   if (t > 0x8000) t = 0x8000;
+   m = ((t - 1) * 0x00010001) | 0x80008000;
+   if (n && ((unsigned int)p & 2)) { c = (*p++ < t); n--; }  // word align
+   for (w = (const volatile unsigned int *)p; n >= 2; n -= 2)
+      a += ((m - *w++) >> 15) & 0x00010001;
+   c += (a & 0xFFFF) + (a >> 16);
+   if (n) c += (*(const volatile unsigned short *)w < t);
+#else
+   while (n--) c += (*p++ < t);
+#endif
+   return c;
+}
+/*******************************************************************************
+ Function Name : Sum_Squares
+ Description : sum of (sample - t)^2 over n samples of 12 bits, *a is raised
+               by the sum of |sample - t|. t is taken as signed and exact
+               while |t| < 2^24
+ NOTE : a square of 12 bit differences is below 2^24, so blocks of 256 are
+        summed with 32 bit multiply-accumulates and folded into the 64 bit
+        total. A t beyond 0..4095 is clamped to the nearest end, which puts
+        all samples on one side of it, and the distance k it moved adds
+        2k|d| + k^2 to each square and k to each |d|
+*******************************************************************************/
+unsigned long long Sum_Squares(const volatile unsigned short *p, unsigned short n, unsigned int t, unsigned int *a)
+{
+   unsigned long long s = 0;
+   unsigned int q, b = 0, k = 0;
+   unsigned short c, m = n;
+   int d;
+
+   if (t > 4095) {
+      k = ((int)t < 0) ? -t : t - 4095;
+      t = ((int)t < 0) ? 0 : 4095;
+   }
+   while (n) {
+      c = (n > 256) ? 256 : n;
+      n -= c;
+      for (q = 0; c; c--) {
+         d = *p++ - t;
+         q += d * d;
+         b += (d < 0) ? -d : d;
+      }
+      s += q;
+   }
+   *a += b + m * k;
+   return s + 2ULL * k * b + (unsigned long long)m * k * k;
+}
 /********************************* END OF FILE ********************************/
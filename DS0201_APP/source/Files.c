@@ -21,11 +21,11 @@ unsigned const char BmpHead[54] = {
    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
    0x00, 0x00, 0x00, 0x00, 0x00, 0x00
 };
-unsigned int    Root_Addr, File_Addr, Dir_Addr, FDT_Start, FDT_Cluster, ClusterNum, FAT1_Addr;
+unsigned int    File_Size, Root_Addr, File_Addr, Dir_Addr, FDT_Start, FDT_Cluster, ClusterNum, FAT1_Addr;
 
 unsigned short  SectorSize, SecPerClus, DirBlkNum, Dir_Offset;
 
-unsigned char   FAT16, F_Buff[512];
+unsigned char   FAT16;
 
 /*******************************************************************************
 Function Name : FAT_Info
@@ -162,10 +162,9 @@ char Open_File(unsigned const char *name, unsigned char *num, unsigned const cha
          if (F_Buff[i + 0x0b] & 0x1f) continue; // skip directory, volume label, system,  hidden, read only
          if (DirMatch(F_Buff + i, name, j) && DirMatch(F_Buff + i + 8, ext, 3) && DirMatch(F_Buff + i + j, num, 3))
          {
-            unsigned int FileSize;
-            FileSize = (F_Buff[i + 0x1f] << 24) + (F_Buff[i + 0x1e] << 16)
+            File_Size = (F_Buff[i + 0x1f] << 24) + (F_Buff[i + 0x1e] << 16)
                         + (F_Buff[i + 0x1d] << 8) + (F_Buff[i + 0x1c]);
-            if (FileSize == 0)
+            if (File_Size == 0)
               return 0xff;  // file exists, but is empty
 
             if (FAT16) {
@@ -257,6 +256,18 @@ char            Write_File(void)
    return rval;
 }
 
+/*******************************************************************************
+Function Name : Next_Sector
+Description : move File_Addr from the first to the second sector of the opened
+              file, following the cluster chain if needed (overwrites F_Buff)
+*******************************************************************************/
+char            Next_Sector(void)
+{
+   File_Addr += 512;
+   if ((SectorSize/512*SecPerClus) > 1) return 0;
+   return SetClusterNext();
+}
+
 /*******************************************************************************
 Function Name : Read_Parameter
 Description : read the user setting parameter from flash
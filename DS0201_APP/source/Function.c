@@ -14,7 +14,6 @@ File Name: Function.c
 #include "string.h"
 #include "Files.h"
 #include "stm32_dsp.h"
-#include <math.h>
 
 //-----------------------------------------------------------------------------
 
@@ -34,114 +33,217 @@ unsigned char   Toggle, Sync, SyncSegment;
 
 unsigned char MeFr, MeDC;   // flag variable to indicate if frequency/DC related parameters are up to date
 int      Frequency, Duty, Vpp, Vrms, Vavg, Vdc, Vmin, Vmax;
+int      Vtone = NO_MEASURE;      // rms of the strongest tone of the tone detector
+int      Rise, Fall, PWidth, NWidth, Period, Overshoot, Preshoot; // ns and 1/1000 %, NO_MEASURE if not found
+int      Thd = NO_MEASURE, ThdN = NO_MEASURE;   // 1/1000 %, from the plain FFT
+int      Rate = NO_MEASURE;       // waveform update rate, records measured per 1000 s
+unsigned short Rate_Frames;       // records measured since Rate_Time was cleared
+volatile unsigned short Rate_Time;  // ms, counted up by the 1ms tick
+
+// pulse measurements: 10%, 50%, 90% crossings between the top and base level
+typedef struct _PulseType {
+  int            L[3];           // 10%, 50%, 90% levels, ADC (falls as the signal rises)
+  int            Ta, Tb;         // last rising 10%, falling 90% crossing
+  int            Tr, Tf;         // last rising, falling 50% crossing
+  int            Er, Ef;         // 50% crossing of the last complete rising, falling edge
+  unsigned char  Ra, Fa, Ev;     // Ta, Tb valid; Ev bit 0 Er valid, bit 1 Ef valid
+  int            Rise, Fall, Pw, Nw;   // sums, 1/256 sample
+  unsigned short Nr, Nf, Np, Nn;       // and their counts
+} PulseType;
+
+PulseType       Pulse;
+ScratchType     Scratch;
+// the FFT arrays size the scratch block, a member outgrowing them fails here
+typedef char Scratch_Check[(sizeof(ScratchType) == sizeof(((ScratchType *)0)->Fft)) ? 1 : -1];
+// FFT_Combine joins the largest FFT from exactly four parts
+typedef char FFT_Part_Check[(FFT_MAX == 4 * FFT_PART) ? 1 : -1];
+// the record copy of the largest zoom fits below the mixer's sums and filter
+typedef char Zoom_Check[((FFT_PART + ZOOM_TAPS - 1) * ZOOM_DEC_MAX * 3 / 2 + 2
+                         <= sizeof(((ScratchType *)0)->Zoom.Rec)) ? 1 : -1];
+
+StatType        Stat[N_MEASURE];
+unsigned const short Stat_Window[N_STAT_WINDOW] = {0, 4, 16, 64, 256}; // by Item_Index[MEASURE_STATS], 0: since reset
+
+volatile CounterType Counter;
+unsigned int  Counter_Freq, Counter_Period;  // last gate, mHz and ps (ns if Counter_TUnit)
+unsigned char Counter_TUnit;
+unsigned const short Gate_Time[4] = {0, 100, 1000, 10000}; // ms, indexed by Item_Index[COUNTER_GATE]
 
 unsigned const short Ks[22] =   // interpolation coefficient of the horizontal scanning interval
  {29860, 14930, 5972, 2986, 1493, 1024, 1024, 1024, 1024, 1024, 1024, 1024, 1024, 1024, 1024, 1024, 1024, 1024, 1024, 1024, 1024, 1024};
 
 // ------------ For FFT ---------------------------------------------------
 
-#define NP        256   // Number of FFT points: 64, 256 or 1024
-
 #define X_OFFSET  3     // Offset from the right of the screen (in pixels)
 #define SPLIT_X   (1 + X_OFFSET)  // left = fft, right = wave
-
-int FFT_in[NP]; // input array
-int FFT_out[NP + 2];  // one extra element
-unsigned const char F_Unit_DUPLICATE[4][4] = {"Hz ", "Hz ", "kHz", "MHz"}; // REMOVE: already present in menu.c
-
-void Calculate_FFT( void );
-void Erase_FFT(void);
-void Draw_FFT(void);
-
-/* From the ST DSP library */
-void powerMag(int nfill, char* strPara);
-void onesided(int nfill);
-
-/* Multiplication factors for Hanning window
- * Hanning[i] = 0.5 - 0.5 * cos(2 * PI * i/(64 - 1))
- * Use only half (The windows are symmetric) */
-unsigned const short Hanning64[64] =
-    {
-      0x0000, 0x00A3, 0x028A, 0x05B0, 0x0A0D, 0x0F96, 0x163E, 0x1DF2,
-      0x26A0, 0x3031, 0x3A8E, 0x459B, 0x513D, 0x5D55, 0x69C6, 0x766F,
-      0x8331, 0x8FEA, 0x9C7C, 0xA8C4, 0xB4A5, 0xC000, 0xCAB8, 0xD4B2,
-      0xDDD5, 0xE608, 0xED39, 0xF353, 0xF848, 0xFC0B, 0xFE92, 0xFFD7,
-    };
-
-unsigned const short Hanning256[256] =
-   {
-      0x0000, 0x000A, 0x0028, 0x0059, 0x009F, 0x00F8, 0x0165, 0x01E6,
-      0x027B, 0x0322, 0x03DE, 0x04AC, 0x058E, 0x0683, 0x078A, 0x08A5,
-      0x09D2, 0x0B11, 0x0C62, 0x0DC6, 0x0F3B, 0x10C2, 0x125A, 0x1403,
-      0x15BD, 0x1787, 0x1961, 0x1B4C, 0x1D46, 0x1F50, 0x2168, 0x238F,
-      0x25C5, 0x2809, 0x2A5A, 0x2CB9, 0x2F24, 0x319C, 0x3421, 0x36B1,
-      0x394C, 0x3BF3, 0x3EA4, 0x415F, 0x4424, 0x46F2, 0x49C9, 0x4CA9,
-      0x4F90, 0x527F, 0x5575, 0x5872, 0x5B75, 0x5E7E, 0x618B, 0x649E,
-      0x67B5, 0x6ACF, 0x6DED, 0x710E, 0x7431, 0x7755, 0x7A7B, 0x7DA2,
-      0x80CA, 0x83F1, 0x8718, 0x8A3D, 0x8D61, 0x9083, 0x93A2, 0x96BF,
-      0x99D7, 0x9CEC, 0x9FFC, 0xA307, 0xA60D, 0xA90D, 0xAC07, 0xAEF9,
-      0xB1E5, 0xB4C8, 0xB7A3, 0xBA76, 0xBD40, 0xC000, 0xC2B6, 0xC562,
-      0xC803, 0xCA99, 0xCD23, 0xCFA1, 0xD213, 0xD478, 0xD6D0, 0xD91B,
-      0xDB58, 0xDD86, 0xDFA6, 0xE1B7, 0xE3B9, 0xE5AB, 0xE78E, 0xE960,
-      0xEB22, 0xECD4, 0xEE74, 0xF004, 0xF182, 0xF2EE, 0xF449, 0xF591,
-      0xF6C7, 0xF7EB, 0xF8FC, 0xF9FA, 0xFAE5, 0xFBBD, 0xFC82, 0xFD34,
-      0xFDD2, 0xFE5D, 0xFED4, 0xFF37, 0xFF86, 0xFFC2, 0xFFEA, 0xFFFE
-      };
-
-unsigned const short Hanning1024[1024] =
-{
-     0x0000, 0x0001, 0x0002, 0x0006, 0x000A, 0x000F, 0x0016, 0x001E, 0x0028, 0x0032,
-     0x003E, 0x004B, 0x0059, 0x0068, 0x0079, 0x008B, 0x009E, 0x00B2, 0x00C8, 0x00DF,
-     0x00F7, 0x0110, 0x012B, 0x0146, 0x0163, 0x0182, 0x01A1, 0x01C2, 0x01E3, 0x0206,
-     0x022B, 0x0250, 0x0277, 0x029F, 0x02C8, 0x02F2, 0x031E, 0x034A, 0x0378, 0x03A8,
-     0x03D8, 0x0409, 0x043C, 0x0470, 0x04A5, 0x04DC, 0x0513, 0x054C, 0x0586, 0x05C1,
-     0x05FD, 0x063A, 0x0679, 0x06B9, 0x06FA, 0x073C, 0x077F, 0x07C4, 0x0809, 0x0850,
-     0x0898, 0x08E1, 0x092B, 0x0977, 0x09C3, 0x0A11, 0x0A60, 0x0AB0, 0x0B01, 0x0B53,
-     0x0BA6, 0x0BFB, 0x0C50, 0x0CA7, 0x0CFF, 0x0D58, 0x0DB2, 0x0E0D, 0x0E69, 0x0EC6,
-     0x0F25, 0x0F84, 0x0FE5, 0x1046, 0x10A9, 0x110D, 0x1172, 0x11D8, 0x123F, 0x12A7,
-     0x1310, 0x137A, 0x13E6, 0x1452, 0x14BF, 0x152D, 0x159D, 0x160D, 0x167F, 0x16F1,
-     0x1765, 0x17D9, 0x184F, 0x18C5, 0x193D, 0x19B5, 0x1A2F, 0x1AA9, 0x1B25, 0x1BA1,
-     0x1C1E, 0x1C9D, 0x1D1C, 0x1D9C, 0x1E1D, 0x1EA0, 0x1F23, 0x1FA7, 0x202C, 0x20B2,
-     0x2138, 0x21C0, 0x2249, 0x22D2, 0x235D, 0x23E8, 0x2474, 0x2501, 0x258F, 0x261E,
-     0x26AE, 0x273E, 0x27D0, 0x2862, 0x28F5, 0x2989, 0x2A1E, 0x2AB4, 0x2B4A, 0x2BE2,
-     0x2C7A, 0x2D13, 0x2DAC, 0x2E47, 0x2EE2, 0x2F7E, 0x301B, 0x30B9, 0x3157, 0x31F6,
-     0x3296, 0x3337, 0x33D8, 0x347A, 0x351D, 0x35C1, 0x3665, 0x370A, 0x37B0, 0x3856,
-     0x38FD, 0x39A5, 0x3A4D, 0x3AF7, 0x3BA0, 0x3C4B, 0x3CF6, 0x3DA2, 0x3E4E, 0x3EFB,
-     0x3FA9, 0x4057, 0x4106, 0x41B6, 0x4266, 0x4316, 0x43C8, 0x447A, 0x452C, 0x45DF,
-     0x4693, 0x4747, 0x47FC, 0x48B1, 0x4967, 0x4A1D, 0x4AD4, 0x4B8B, 0x4C43, 0x4CFB,
-     0x4DB4, 0x4E6D, 0x4F27, 0x4FE1, 0x509C, 0x5157, 0x5213, 0x52CF, 0x538C, 0x5448,
-     0x5506, 0x55C4, 0x5682, 0x5740, 0x57FF, 0x58BF, 0x597E, 0x5A3F, 0x5AFF, 0x5BC0,
-     0x5C81, 0x5D43, 0x5E05, 0x5EC7, 0x5F89, 0x604C, 0x610F, 0x61D3, 0x6296, 0x635A,
-     0x641F, 0x64E3, 0x65A8, 0x666D, 0x6732, 0x67F8, 0x68BE, 0x6984, 0x6A4A, 0x6B11,
-     0x6BD7, 0x6C9E, 0x6D65, 0x6E2C, 0x6EF4, 0x6FBB, 0x7083, 0x714B, 0x7213, 0x72DB,
-     0x73A3, 0x746B, 0x7534, 0x75FD, 0x76C5, 0x778E, 0x7857, 0x7920, 0x79E9, 0x7AB2,
-     0x7B7B, 0x7C44, 0x7D0D, 0x7DD7, 0x7EA0, 0x7F69, 0x8032, 0x80FC, 0x81C5, 0x828E,
-     0x8357, 0x8420, 0x84EA, 0x85B3, 0x867C, 0x8745, 0x880E, 0x88D6, 0x899F, 0x8A68,
-     0x8B30, 0x8BF9, 0x8CC1, 0x8D89, 0x8E51, 0x8F19, 0x8FE1, 0x90A9, 0x9170, 0x9237,
-     0x92FE, 0x93C5, 0x948C, 0x9553, 0x9619, 0x96DF, 0x97A5, 0x986B, 0x9930, 0x99F5,
-     0x9ABA, 0x9B7F, 0x9C43, 0x9D08, 0x9DCC, 0x9E8F, 0x9F52, 0xA015, 0xA0D8, 0xA19A,
-     0xA25C, 0xA31E, 0xA3E0, 0xA4A1, 0xA561, 0xA622, 0xA6E1, 0xA7A1, 0xA860, 0xA91F,
-     0xA9DD, 0xAA9B, 0xAB59, 0xAC16, 0xACD3, 0xAD8F, 0xAE4B, 0xAF06, 0xAFC1, 0xB07C,
-     0xB136, 0xB1EF, 0xB2A8, 0xB361, 0xB419, 0xB4D1, 0xB588, 0xB63E, 0xB6F4, 0xB7AA,
-     0xB85F, 0xB913, 0xB9C7, 0xBA7A, 0xBB2D, 0xBBDF, 0xBC91, 0xBD42, 0xBDF2, 0xBEA2,
-     0xBF51, 0xC000, 0xC0AE, 0xC15B, 0xC208, 0xC2B4, 0xC360, 0xC40A, 0xC4B5, 0xC55E,
-     0xC607, 0xC6AF, 0xC756, 0xC7FD, 0xC8A3, 0xC949, 0xC9ED, 0xCA91, 0xCB34, 0xCBD7,
-     0xCC79, 0xCD1A, 0xCDBA, 0xCE59, 0xCEF8, 0xCF96, 0xD034, 0xD0D0, 0xD16C, 0xD207,
-     0xD2A1, 0xD33A, 0xD3D2, 0xD46A, 0xD501, 0xD597, 0xD62C, 0xD6C1, 0xD754, 0xD7E7,
-     0xD879, 0xD90A, 0xD99A, 0xDA29, 0xDAB8, 0xDB45, 0xDBD2, 0xDC5E, 0xDCE9, 0xDD73,
-     0xDDFC, 0xDE84, 0xDF0B, 0xDF92, 0xE017, 0xE09B, 0xE11F, 0xE1A2, 0xE223, 0xE2A4,
-     0xE324, 0xE3A3, 0xE420, 0xE49D, 0xE519, 0xE594, 0xE60E, 0xE687, 0xE6FF, 0xE776,
-     0xE7EC, 0xE861, 0xE8D5, 0xE948, 0xE9BA, 0xEA2B, 0xEA9B, 0xEB0A, 0xEB78, 0xEBE4,
-     0xEC50, 0xECBB, 0xED25, 0xED8D, 0xEDF5, 0xEE5B, 0xEEC1, 0xEF25, 0xEF88, 0xEFEB,
-     0xF04C, 0xF0AC, 0xF10B, 0xF169, 0xF1C5, 0xF221, 0xF27C, 0xF2D5, 0xF32D, 0xF385,
-     0xF3DB, 0xF430, 0xF484, 0xF4D6, 0xF528, 0xF579, 0xF5C8, 0xF616, 0xF663, 0xF6AF,
-     0xF6FA, 0xF744, 0xF78C, 0xF7D4, 0xF81A, 0xF85F, 0xF8A3, 0xF8E5, 0xF927, 0xF967,
-     0xF9A6, 0xF9E4, 0xFA21, 0xFA5D, 0xFA97, 0xFAD1, 0xFB09, 0xFB40, 0xFB75, 0xFBAA,
-     0xFBDD, 0xFC0F, 0xFC40, 0xFC70, 0xFC9F, 0xFCCC, 0xFCF8, 0xFD23, 0xFD4D, 0xFD75,
-     0xFD9D, 0xFDC3, 0xFDE8, 0xFE0B, 0xFE2E, 0xFE4F, 0xFE6F, 0xFE8E, 0xFEAB, 0xFEC8,
-     0xFEE3, 0xFEFD, 0xFF15, 0xFF2D, 0xFF43, 0xFF58, 0xFF6C, 0xFF7E, 0xFF8F, 0xFF9F,
-     0xFFAE, 0xFFBC, 0xFFC8, 0xFFD3, 0xFFDD, 0xFFE6, 0xFFED, 0xFFF3, 0xFFF8, 0xFFFC,
-     0xFFFF, 0xFFFF};
+#define FFT_COLS  128   // screen columns of the spectrum, 0 to the Nyquist frequency
+
+#define FFT_PHASE 65536 // steps per period of Cosine, a 16 bit phase wraps by itself
+#define FFT_in    Scratch.Fft.In
+#define FFT_out   Scratch.Fft.Out
+// short of real sample i in FFT_in when the FFT runs in quarters: quarter r
+// takes the complex points r, r + 4, r + 8 .. of the whole transform
+#define FFT_SLOT(i) ((((i) >> 1) & 3) * 2 * FFT_PART + (((i) >> 3) << 1) + ((i) & 1))
+#define FFT_mag   Scratch.Fft.In    // bin magnitudes, the input is spent by then
+
+unsigned const short FFT_Size[N_FFT_SIZE] = {128, 512, 2048};  // real points, by Item_Index[FFT_SIZE]
+unsigned char FFT_Bar[FFT_COLS];  // bar heights on screen, for Erase_FFT
+
+#define FFT_SHIFT 13    // window product to FFT input, 4 x the 12 bit sample around mid scale
+#define FFT_FS    4096  // bin magnitude of a full scale sine, 0 dBFS at the top of the grid
+
+// dB scales, rows per factor 2 in magnitude (6.02 dB), 1.0 = 256, by Item_Index[FFT_SCALE]
+unsigned const short FFT_dB_Rows[N_FFT_SCALE] = {0, 7706, 3853, 1927, 3853};  // linear, 5, 10, 20 dB/div, dBV
+short FFT_Top;    // dBV at the top of the grid on the dBV scale
+
+// spectrum average per screen column, by Item_Index[FFT_AVG]
+#define AVG_OFF   0
+#define AVG_LIN   3     // equal weight over the first FFT_Avg_N frames, then held
+#define AVG_MAX   4     // max hold
+unsigned const char FFT_Avg_N[N_FFT_AVG] = {1, 4, 16, 16, 0};  // frames, exponential after N
+unsigned short FFT_Avg[FFT_COLS];  // column magnitude, 1.0 = 16
+unsigned short FFT_Frames;         // frames in FFT_Avg, 0 restarts
+unsigned int   FFT_Avg_Key;        // settings FFT_Avg was taken with
+
+// zoom, by Item_Index[FFT_ZOOM]: the transform of each zoom and the decimation
+// in front of it, the largest that leaves the view inside the flat part of the
+// low pass and takes (points + ZOOM_TAPS - 1) * decimation <= BUFFER_SIZE.
+// The record holds 11 at most, so x16 already spreads its bins over more
+// columns and a further zoom would add no resolution
+#define ZOOM_WINDOW 3   // Win_Coef row of the low pass, Blackman-Harris
+unsigned const char Zoom_Size[N_FFT_ZOOM] = {0, 1, 1, 1, 1};   // index to FFT_Run
+unsigned const char Zoom_Dec[N_FFT_ZOOM] = {1, 2, 4, 8, 11};
+
+// harmonic analysis of the plain FFT, Item_Index[FFT_HARM] shows it as bars
+#define N_HARM    10    // fundamental and harmonics 2 .. N_HARM
+#define HARM_COLS (FFT_COLS / N_HARM)  // screen columns per bar, two thirds drawn
+#define HARM_MIN  32    // bin magnitude of the weakest fundamental analysed, -42 dBFS
+#define HARM_PCT_MAX 999999   // THD and THD+N clamp, 1/1000 %
+unsigned short Harm_Amp[N_HARM];  // bar heights as bin magnitudes
+
+// bins either side of the fundamental and from DC that THD+N leaves out, the
+// skirt of the window is below -70 dB beyond. Rect and Hamming never get
+// there, by Item_Index[FFT_WINDOW], 0: no THD or THD+N
+unsigned const char Harm_Notch[N_FFT_WINDOW] = {0, 12, 0, 4, 5};
+
+// tone detector, Item_Index[FFT_HARM] at FFT_VIEW_TONE: one Goertzel resonator
+// per tone of the set picked by Item_Index[TONE_SET], over the whole record.
+// Item_Index[TONE_PICK] is the tone Vtone gives, 0 the strongest
+#define TONE_COLS  (FFT_COLS / N_TONE)  // screen columns per bar, two thirds drawn
+#define TONE_SHIFT 17     // window product to resonator input, 1/8 of the sample on average
+#define TONE_MIN   (0x100000000ULL * 2 / BUFFER_SIZE)  // phase step of 2 record bins
+unsigned const short Tone_Hz[N_TONE_SET - 1][N_TONE] = {
+  {50, 100, 150, 200, 250, 300, 350, 400},       // mains hum and its harmonics
+  {60, 120, 180, 240, 300, 360, 420, 480},
+  {697, 770, 852, 941, 1209, 1336, 1477, 1633}   // DTMF rows, then columns
+};   // the last set is Item_Index[FFT_CENTER] and its harmonics
+
+#define Tone      Scratch.Tones.R
+#define Tone_Rec  Scratch.Tones.Rec
+// the record copy of the zoom mixer, l samples at the top of Zoom.Rec
+#define ZOOM_REC(l) (Scratch.Zoom.Rec + sizeof(Scratch.Zoom.Rec) - ((l) * 3 + 1) / 2)
+
+// FFT stages. FFT_Window takes the record as the capture completes, the
+// others run one per main loop pass from FFT_Step while the next capture fills
+#define FFT_IDLE      0
+#define FFT_TONE      1   // the tone resonators, FFT_SLICE samples a pass
+#define FFT_MIX       2   // the zoom mixer, FFT_SLICE samples a pass
+#define FFT_WEIGHT    3   // the window over the plain FFT input
+#define FFT_TRANSFORM 4   // the ST library FFT, the largest a quarter a pass
+#define FFT_COMBINE   5   // the quarters joined into the largest FFT
+#define FFT_SPECTRUM  6   // bin magnitudes
+#define FFT_DRAW      7   // peak, harmonics, bars and the peak readout
+#define FFT_SLICE   512   // record samples a pass of a sliced stage
+
+typedef struct _FFTJobType {
+  unsigned char  Stage;   // stage FFT_Step runs next
+  unsigned char  Size;    // FFT_Run index of the transform
+  unsigned char  Zoom;    // 0 for the plain FFT
+  unsigned char  Gain;    // zoomed, log2 of the low pass DC gain
+  unsigned short Pos;     // progress of a stage run over several passes
+  unsigned short M;       // complex points of the transform
+  unsigned short N;       // points the view shows as, over the full sample rate
+  unsigned short H;       // zoomed, bins either side of the center
+  unsigned short First;   // first bin drawn
+  unsigned int   R;       // bins per sample rate
+  int            Mean;    // record mean, ADC
+} FFTJobType;
+
+FFTJobType FFT_Job;   // the frame in flight
+
+void FFT_Window(void);
+void Draw_FFT(unsigned short n, unsigned short first);
+unsigned int FFT_Peak(unsigned short lo, unsigned short hi);
+static void FFT_Harmonics(unsigned short n, unsigned int peak);
+
+
+/* Quarter wave of the cosine, Cos_Table[k] = 32768 * cos(PI / 2 * k / 256)
+ * One period is 1024 steps, the other quadrants follow by symmetry */
+unsigned const short Cos_Table[257] =
+  {
+   0x8000, 0x7FFF, 0x7FFE, 0x7FFA, 0x7FF6, 0x7FF1, 0x7FEA, 0x7FE2,
+   0x7FD9, 0x7FCE, 0x7FC2, 0x7FB5, 0x7FA7, 0x7F98, 0x7F87, 0x7F75,
+   0x7F62, 0x7F4E, 0x7F38, 0x7F22, 0x7F0A, 0x7EF0, 0x7ED6, 0x7EBA,
+   0x7E9D, 0x7E7F, 0x7E60, 0x7E3F, 0x7E1E, 0x7DFB, 0x7DD6, 0x7DB1,
+   0x7D8A, 0x7D63, 0x7D3A, 0x7D0F, 0x7CE4, 0x7CB7, 0x7C89, 0x7C5A,
+   0x7C2A, 0x7BF9, 0x7BC6, 0x7B92, 0x7B5D, 0x7B27, 0x7AEF, 0x7AB7,
+   0x7A7D, 0x7A42, 0x7A06, 0x79C9, 0x798A, 0x794A, 0x790A, 0x78C8,
+   0x7885, 0x7840, 0x77FB, 0x77B4, 0x776C, 0x7723, 0x76D9, 0x768E,
+   0x7642, 0x75F4, 0x75A6, 0x7556, 0x7505, 0x74B3, 0x7460, 0x740B,
+   0x73B6, 0x735F, 0x7308, 0x72AF, 0x7255, 0x71FA, 0x719E, 0x7141,
+   0x70E3, 0x7083, 0x7023, 0x6FC2, 0x6F5F, 0x6EFB, 0x6E97, 0x6E31,
+   0x6DCA, 0x6D62, 0x6CF9, 0x6C8F, 0x6C24, 0x6BB8, 0x6B4B, 0x6ADD,
+   0x6A6E, 0x69FD, 0x698C, 0x691A, 0x68A7, 0x6832, 0x67BD, 0x6747,
+   0x66D0, 0x6657, 0x65DE, 0x6564, 0x64E9, 0x646C, 0x63EF, 0x6371,
+   0x62F2, 0x6272, 0x61F1, 0x616F, 0x60EC, 0x6068, 0x5FE4, 0x5F5E,
+   0x5ED7, 0x5E50, 0x5DC8, 0x5D3E, 0x5CB4, 0x5C29, 0x5B9D, 0x5B10,
+   0x5A82, 0x59F4, 0x5964, 0x58D4, 0x5843, 0x57B1, 0x571E, 0x568A,
+   0x55F6, 0x5560, 0x54CA, 0x5433, 0x539B, 0x5303, 0x5269, 0x51CF,
+   0x5134, 0x5098, 0x4FFB, 0x4F5E, 0x4EC0, 0x4E21, 0x4D81, 0x4CE1,
+   0x4C40, 0x4B9E, 0x4AFB, 0x4A58, 0x49B4, 0x490F, 0x486A, 0x47C4,
+   0x471D, 0x4675, 0x45CD, 0x4524, 0x447B, 0x43D1, 0x4326, 0x427A,
+   0x41CE, 0x4121, 0x4074, 0x3FC6, 0x3F17, 0x3E68, 0x3DB8, 0x3D08,
+   0x3C57, 0x3BA5, 0x3AF3, 0x3A40, 0x398D, 0x38D9, 0x3825, 0x3770,
+   0x36BA, 0x3604, 0x354E, 0x3497, 0x33DF, 0x3327, 0x326E, 0x31B5,
+   0x30FC, 0x3042, 0x2F87, 0x2ECC, 0x2E11, 0x2D55, 0x2C99, 0x2BDC,
+   0x2B1F, 0x2A62, 0x29A4, 0x28E5, 0x2827, 0x2768, 0x26A8, 0x25E8,
+   0x2528, 0x2467, 0x23A7, 0x22E5, 0x2224, 0x2162, 0x209F, 0x1FDD,
+   0x1F1A, 0x1E57, 0x1D93, 0x1CD0, 0x1C0C, 0x1B47, 0x1A83, 0x19BE,
+   0x18F9, 0x1833, 0x176E, 0x16A8, 0x15E2, 0x151C, 0x1455, 0x138F,
+   0x12C8, 0x1201, 0x113A, 0x1073, 0x0FAB, 0x0EE4, 0x0E1C, 0x0D54,
+   0x0C8C, 0x0BC4, 0x0AFB, 0x0A33, 0x096B, 0x08A2, 0x07D9, 0x0711,
+   0x0648, 0x057F, 0x04B6, 0x03ED, 0x0324, 0x025B, 0x0192, 0x00C9,
+   0x0000,
+  };
+
+/* Window functions as sums of cosines, w(i) = c0 + c1 cos(x) + c2 cos(2x) + ...
+ * with x = 2 * PI * i / n. Coefficients are 1.0 = 32768 and scaled to the
+ * coherent gain of the Hann window, so a tone reads the same with every window */
+short const Win_Coef[N_FFT_WINDOW][5] =
+  {
+    {16384,      0,     0,     0,   0},  // Rectangular
+    {16384, -16384,     0,     0,   0},  // Hann
+    {16384, -13957,     0,     0,   0},  // Hamming
+    {16384, -22300,  6452,  -533,   0},  // Blackman-Harris, 4 term
+    {16384, -31664, 21072, -6352, 528},  // Flat top
+  };
+
+/* The parabola through the log magnitudes is exact only for a Gaussian window.
+ * Its vertex x is mapped to the tone offset by x * (c1 + c3 x^2 + c5 x^4),
+ * fitted per window over offsets -0.5..0.5 bin, 1.0 = 4096 */
+int const Peak_Fix[N_FFT_WINDOW][3] =
+  {
+    {10507, -63743, 158289},  // Rectangular
+    { 3789,    840,   1539},  // Hann
+    { 3790,    834,   1536},  // Hamming
+    { 4029,    254,     55},  // Blackman-Harris
+    { 2392,  -6528,  51296},  // Flat top
+  };
+
+// the ST radix-4 FFT for each size, by Item_Index[FFT_SIZE]. The largest
+// runs as four FFT_PART point transforms, Fft.Out only holds one
+void (*const FFT_Run[N_FFT_SIZE])(void *pssOUT, void *pssIN, u16 Nbin) =
+  {cr4_fft_64_stm32, cr4_fft_256_stm32, cr4_fft_256_stm32};
 
 /*******************************************************************************
  Function Name : Mark_Trig
@@ -257,13 +359,27 @@ int SigToAdc(int sig)
   return adc;
 }
 
+/*******************************************************************************
+ Function Name : Column_Pos
+ Description : trigger order index of the sample shown in screen column x
+               (0..X_SIZE - 1), may be outside of the buffer
+*******************************************************************************/
+static int Column_Pos(unsigned short x)
+{
+   int p = t0;
+
+   if ((ScanMode != 1) && (ScanMode != 2))  // ignore trigger/x offset when in continues scan mode
+     p += BUFFER_SIZE - Item_Index[TP] - 150;
+   return p + (x * 1024) / Ks[Item_Index[X_SENSITIVITY]];
+}
+
 /*******************************************************************************
  Function Name : Process_Wave
  Description : process sampling buffer and put results in signal buffer
 *******************************************************************************/
 void    Process_Wave(void)
 {
-   int             p, q;
+   int             q;
    int             Vs;
    unsigned short  t;  // relative position of last capture
 
@@ -275,13 +391,9 @@ void    Process_Wave(void)
      if (t >= BUFFER_SIZE) t -= BUFFER_SIZE;
    }
 
-   p = t0;
-   if ((ScanMode != 1) && (ScanMode != 2))  // ignore trigger/x offset when in continues scan mode
-     p += BUFFER_SIZE - Item_Index[TP] - 150;
-
    for (; X2_Counter < X_SIZE; X2_Counter++)
    {
-      q = p + (X2_Counter * 1024) / Ks[Item_Index[X_SENSITIVITY]];
+      q = Column_Pos(X2_Counter);
       if (q < 0)
       {
         Erase_Wave(X1_Counter, X2_Counter + 1);
@@ -411,6 +523,8 @@ void    Stop_Wave(void)
   ADC_Stop();
   Erase_Wave(0, X_SIZE);
   Sync = 0;
+  Rate_Frames = 0;  // the rate counts from the restart
+  Rate_Time = 0;
 }
 
 /*******************************************************************************
@@ -420,18 +534,6 @@ void    Stop_Wave(void)
 *******************************************************************************/
 void    Scan_Wave(void)
 {
-    //--------------------Common-------------------------
-    if (Item_Index[RUNNING_STATUS] == RUN)
-    {
-       if ((Sync <= 1) && (ScanMode == 0)) { // we must restart sampling
-          Sync = 0;
-          t0 = SEGMENT_SIZE; // start to look for trigger in first position, second segment
-          t0_scan = 0;
-          ADC_Start();
-          Refresh_Counter = 100;  // keep waveform for 100ms
-       }
-    }
-
    //--------------------SCAN-----------------------------
     if (Item_Index[SYNC_MODE] == 3) { // 3:SCAN
       if ((Sync <= 1) && (ScanMode >= 1)) {
@@ -507,6 +609,313 @@ void    Scan_Wave(void)
          Update[SYNC_MODE] = 1;
       }
    }
+
+    //--------------------Common-------------------------
+    // last, so sampling restarts in the pass that measured the record and
+    // the FFT stages of the following passes overlap the next capture
+    if (Item_Index[RUNNING_STATUS] == RUN)
+    {
+       if ((Sync <= 1) && (ScanMode == 0)) { // we must restart sampling
+          Sync = 0;
+          t0 = SEGMENT_SIZE; // start to look for trigger in first position, second segment
+          t0_scan = 0;
+          ADC_Start();
+          Refresh_Counter = 100;  // keep waveform for 100ms
+       }
+    }
+}
+
+/*******************************************************************************
+ Function Name : Linear_Run
+ Description : start and length of the linear part of n samples taken from
+               trigger order index i, the rest continues at Scan_Buffer[0]
+*******************************************************************************/
+static unsigned short Linear_Run(unsigned short i, unsigned short n, const volatile unsigned short **q)
+{
+   unsigned short j = i + tp_to_abs;
+
+   if (j >= BUFFER_SIZE) j -= BUFFER_SIZE;
+   *q = &Scan_Buffer[j];
+   return (n < BUFFER_SIZE - j) ? n : BUFFER_SIZE - j;
+}
+
+/*******************************************************************************
+ Function Name : Pack_Record
+ Description : copy n samples from trigger order index i to r at 12 bit, two
+               in three bytes: sample j of the copy starts at byte j + j / 2,
+               the even one in the low 12 bits of its pair. Returns their sum
+*******************************************************************************/
+static unsigned int Pack_Record(unsigned char *r, unsigned short i, unsigned short n)
+{
+   const volatile unsigned short *q;
+   unsigned short k = Linear_Run(i, n, &q), a, b;
+   unsigned int sum = 0;
+
+   for (; n >= 2; n -= 2, r += 3)
+   {
+      a = *q++;
+      if (--k == 0) q = Scan_Buffer;   // the second run
+      b = *q++;
+      if (--k == 0) q = Scan_Buffer;
+      r[0] = a;
+      r[1] = (a >> 8) | (b << 4);
+      r[2] = b >> 4;
+      sum += a + b;
+   }
+   if (n)
+   {
+      r[0] = *q;
+      r[1] = *q >> 8;
+      sum += *q;
+   }
+   return sum;
+}
+
+/*******************************************************************************
+ Function Name : Packed
+ Description : sample j of a copy made by Pack_Record
+*******************************************************************************/
+static int Packed(const unsigned char *r, unsigned short j)
+{
+   r += j + (j >> 1);
+   return (j & 1) ? (r[0] >> 4) | (r[1] << 4) : r[0] | ((r[1] & 15) << 8);
+}
+
+/*******************************************************************************
+ Function Name : Sample_ns
+ Description : time of t samples / 2^shift in ns at the current sample rate
+*******************************************************************************/
+static int Sample_ns(unsigned long long t, unsigned char shift)
+{
+   unsigned long long k = (Scan_PSC[Item_Index[X_SENSITIVITY]] + 1) * (Scan_ARR[Item_Index[X_SENSITIVITY]] + 1);
+
+   t = ((t * k * 125) >> shift) / 9; // sample time is k / 72MHz = k * 125 / 9 ns
+   return (t > 0x7FFFFFFF) ? 0x7FFFFFFF : t;
+}
+
+/*******************************************************************************
+ Function Name : Pulse_Cross
+ Description : samples u -> v at i moved the signal from zone zu to z, zone is
+               the number of Pulse.L levels it is above. A rising edge is
+               complete when it reaches 90% after leaving 10%, a falling
+               one when it reaches 10% after leaving 90%; widths run from
+               the 50% crossing of one complete edge to that of the next
+*******************************************************************************/
+static void Pulse_Cross(unsigned short i, int u, int v, unsigned char zu, unsigned char z)
+{
+   unsigned char k;
+   int t;
+
+   if (z > zu) { // rising, levels zu .. z - 1 from 10% up
+      for (k = zu; k < z; k++) {
+         t = (i - 1) * 256 + (u - Pulse.L[k]) * 256 / (u - v);
+         if (k == 0) {
+            Pulse.Ta = t;
+            Pulse.Ra = 1;
+         } else if (k == 1)
+            Pulse.Tr = t;
+         else if (Pulse.Ra) {
+            Pulse.Rise += t - Pulse.Ta;
+            Pulse.Nr++;
+            Pulse.Ra = 0;
+            if (Pulse.Ev & 2) {
+               Pulse.Nw += Pulse.Tr - Pulse.Ef;
+               Pulse.Nn++;
+            }
+            Pulse.Er = Pulse.Tr;
+            Pulse.Ev |= 1;
+         }
+      }
+   } else {      // falling, levels zu - 1 .. z from 90% down
+      for (k = zu; k-- > z; ) {
+         t = (i - 1) * 256 + (u - Pulse.L[k]) * 256 / (u - v);
+         if (k == 2) {
+            Pulse.Tb = t;
+            Pulse.Fa = 1;
+         } else if (k == 1)
+            Pulse.Tf = t;
+         else if (Pulse.Fa) {
+            Pulse.Fall += t - Pulse.Tb;
+            Pulse.Nf++;
+            Pulse.Fa = 0;
+            if (Pulse.Ev & 1) {
+               Pulse.Pw += Pulse.Tf - Pulse.Er;
+               Pulse.Np++;
+            }
+            Pulse.Ef = Pulse.Tf;
+            Pulse.Ev |= 2;
+         }
+      }
+   }
+}
+
+/*******************************************************************************
+ Function Name : Pulse_Level
+ Description : mean of the samples in the most populated bin of b1..b2 (step
+               +-1) and in its neighbours holding half as many, which
+               keeps edges and spikes out; the extreme x when no bin stands
+               out (sine, triangle)
+*******************************************************************************/
+static int Pulse_Level(int b1, int b2, int step, int x)
+{
+   unsigned int c, m = 0, s = 0, nb = 0, total = 0;
+   int b, bm = b1;
+
+   for (b = b1; b != b2 + step; b += step) {
+      c = Scratch.Pulse.Hist[b];
+      total += c;
+      nb++;
+      if (c > m) m = c, bm = b;
+   }
+   if (m * nb < 2 * total) return x;   // under twice the mean density
+   c = m;
+   m = 0;
+   for (b = bm - step; b != bm + 2 * step; b += step)
+      if (((b - b1) * step >= 0) && ((b2 - b) * step >= 0) && (Scratch.Pulse.Hist[b] * 2 >= c)) {
+         m += Scratch.Pulse.Hist[b];
+         s += Scratch.Pulse.HSum[b];
+      }
+   return s / m;
+}
+
+/*******************************************************************************
+ Function Name : Pulse_Measure
+ Description : rise/fall time, widths, overshoot and preshoot of samples
+               g1..g2 - 1. Top and base come from the histogram halves above
+               and below the middle of lo..hi (ADC, the top is low) that the
+               measure pass collected, then a second pass takes the
+               crossings of the levels of the same record
+*******************************************************************************/
+static void Pulse_Measure(unsigned short lo, unsigned short hi, unsigned short g1, unsigned short g2)
+{
+   int Top, Base, A, m = ((lo + hi) / 2) >> 6;
+   const volatile unsigned short *p;
+   unsigned short i, n, u, v;
+   unsigned char z, zu;
+
+   Rise = Fall = PWidth = NWidth = Overshoot = Preshoot = NO_MEASURE;
+   if ((hi >> 6) - (lo >> 6) < 2) return; // flat, no levels
+   Top = Pulse_Level(lo >> 6, m - 1, 1, lo);
+   Base = Pulse_Level(hi >> 6, m + 1, -1, hi);
+   A = Base - Top;
+   Pulse.L[0] = Base - A / 10;
+   Pulse.L[1] = Base - A / 2;
+   Pulse.L[2] = Base - A * 9 / 10;
+
+   Overshoot = (Top - lo) * 100000 / A;
+   Preshoot = (hi - Base) * 100000 / A;
+
+   // in trigger order over g1..g2 - 1, as the measure pass
+   memset(&Pulse.Ra, 0, (char *)&Pulse.Nn + sizeof(Pulse.Nn) - (char *)&Pulse.Ra);
+   n = g1 + Linear_Run(g1, g2 - g1, &p);
+   u = *p;
+   zu = (u < Pulse.L[0]) + (u < Pulse.L[1]) + (u < Pulse.L[2]);
+   for (i = g1; i < g2; p = Scan_Buffer, n = g2)
+   {
+      for (; i < n; i++, u = v)
+      {
+         v = *p++;
+         z = (v < Pulse.L[0]) + (v < Pulse.L[1]) + (v < Pulse.L[2]);
+         if (z != zu)
+         {
+            Pulse_Cross(i, u, v, zu, z);
+            zu = z;
+         }
+      }
+   }
+   if (Pulse.Nr) Rise = Sample_ns(Pulse.Rise / Pulse.Nr, 8);
+   if (Pulse.Nf) Fall = Sample_ns(Pulse.Fall / Pulse.Nf, 8);
+   if (Pulse.Np) PWidth = Sample_ns(Pulse.Pw / Pulse.Np, 8);
+   if (Pulse.Nn) NWidth = Sample_ns(Pulse.Nw / Pulse.Nn, 8);
+}
+
+/*******************************************************************************
+ Function Name : Measure_Value
+ Description : value of measure kind k (MeFreq + k in the menu), or NO_VALUE
+               when the last record did not give it
+*******************************************************************************/
+int Measure_Value(unsigned char k)
+{
+   int t;
+
+   switch (k)
+   {
+   case 0:  return MeFr ? Frequency : NO_VALUE;
+   case 1:  return MeFr ? Duty : NO_VALUE;
+   case 2:  return MeFr ? Vrms : NO_VALUE;
+   case 3:  return MeFr ? Vavg : NO_VALUE;
+   case 4:  return MeDC ? Vpp : NO_VALUE;
+   case 5:  return MeDC ? Vdc : NO_VALUE;
+   case 6:  return MeDC ? Vmin : NO_VALUE;
+   case 7:  return MeDC ? Vmax : NO_VALUE;
+   case 8:  t = Vtone;     break;
+   case 9:  t = Rise;      break;
+   case 10: t = Fall;      break;
+   case 11: t = PWidth;    break;
+   case 12: t = NWidth;    break;
+   case 13: t = Period;    break;
+   case 14: t = Overshoot; break;
+   case 15: t = Preshoot;  break;
+   case 16: t = Thd;       break;
+   case 17: t = ThdN;      break;
+   case 18: t = Rate;      break;
+   default: return NO_VALUE;
+   }
+   return (t == NO_MEASURE) ? NO_VALUE : t;
+}
+
+/*******************************************************************************
+ Function Name : Stat_Reset
+ Description : restart the statistics of all measure kinds
+*******************************************************************************/
+void Stat_Reset(void)
+{
+   memset(Stat, 0, sizeof(Stat));
+}
+
+/*******************************************************************************
+ Function Name : Stat_Update
+ Description : add the values of this record to the running statistics,
+               d * e is the Welford M2 increment, kept as the variance itself
+               (Var += (d * e - Var) / n) so it needs no 1/n at read out.
+               d, e are in 1/65536 unit and shifted down to 32 bit for a
+               32x32 bit product, the variance clamps at 2^62 (deviations
+               beyond 2^27 units). The remainders of the divisions by n are
+               carried over, without them the small steps of Mean and Var
+               once n is large would be lost and the mean would lag a level
+               change by up to n / 65536 unit
+*******************************************************************************/
+static void Stat_Update(void)
+{
+   StatType *s = Stat;
+   unsigned char k;
+   unsigned short w = Stat_Window[Item_Index[MEASURE_STATS]];
+   long long d, e, m;
+   int v, n, sh;
+
+   for (k = 0; k < N_MEASURE; k++, s++) {
+      v = Measure_Value(k);
+      if (v == NO_VALUE) continue;
+      if (s->Count < 0xffff) s->Count++;
+      if (s->Count == 1) s->Min = s->Max = v;
+      if (v < s->Min) s->Min = v;
+      if (v > s->Max) s->Max = v;
+      n = ((w != 0) && (s->Count > w)) ? w : s->Count;
+      d = ((long long)v << 16) - s->Mean;
+      m = d + s->MRem;
+      s->Mean += m / n;
+      s->MRem = m % n;
+      e = ((long long)v << 16) - s->Mean;
+      for (sh = 0; ((d >> sh) != (int)(d >> sh)) || ((e >> sh) != (int)(e >> sh)); sh += 4);
+      m = (long long)(int)(d >> sh) * (int)(e >> sh);   // 1/2^(32 - 2 sh) unit^2
+      if (sh < 12)
+         m = (m + (1LL << (23 - 2 * sh))) >> (24 - 2 * sh);   // rounded, a floor biases Var low
+      else if (sh > 12)
+         m = (m < ((1LL << 62) >> (2 * sh - 24))) ? m << (2 * sh - 24) : (1LL << 62);
+      m += s->Rem - s->Var;
+      s->Var += m / n;
+      s->Rem = m % n;
+   }
 }
 
 /*******************************************************************************
@@ -516,11 +925,27 @@ void    Scan_Wave(void)
 *******************************************************************************/
 void      Measure_Wave(void)
 {
-   unsigned short  i, j, t_max = 0xffff, t_min = 0, Trig = 0;
+   unsigned short  i, n, u, v, t_max = 0xffff, t_min = 0, Trig = 0;
+   const volatile unsigned short *p, *q;
    unsigned int    Threshold0, Threshold1, Threshold2, Threshold3;
-   int             Vk = 0, Vn, Vm, Vp, Vq, Tmp1, Tmp2;
-   unsigned short  Edge, First_Edge, Last_Edge;
-
+   int             Vk, Vm, Tmp1, Tmp2;
+   int             Sh = 0;
+   unsigned int    Sq;
+   unsigned long long Sn;
+   int             t, First_T = 0, Last_T = 0, First_H = 0, Last_H = 0;
+   unsigned long long St = 0, Set = 0, Tp;
+   unsigned short  Edge, First_Edge, Last_Edge, Vlo = 0xffff, Vhi = 0;
+   unsigned short  g1 = 0, g2 = BUFFER_SIZE;
+
+   FFT_Finish();  // the previous frame still holds the scratch block
+
+   if (Item_Index[MEASURE_GATE])  // only the samples between the T1 and T2 columns
+   {
+      t = Column_Pos(Item_Index[T1] - MIN_X);
+      g1 = (t < 0) ? 0 : (t > BUFFER_SIZE - 2) ? BUFFER_SIZE - 2 : t;
+      t = Column_Pos(Item_Index[T2] - MIN_X) + 1;
+      g2 = (t < g1 + 2) ? g1 + 2 : (t > BUFFER_SIZE) ? BUFFER_SIZE : t;
+   }
    Edge = 0,
    First_Edge = 0;
    Last_Edge = 0;
@@ -529,78 +954,116 @@ void      Measure_Wave(void)
    Threshold2 = SigToAdc(Item_Index[VT] + Item_Index[TRIG_SENSITIVITY]);
    Threshold3 = SigToAdc(Item_Index[VT]);
 
-   for (i = 0; i < BUFFER_SIZE; i++)
+   // one pass in trigger order over g1..g2 - 1 for the edges, the circular
+   // buffer is walked as up to two linear runs, the second from Scan_Buffer[0]
+   // edge times t are interpolated where u -> v crosses Threshold2, in 1/256
+   // sample, and fitted by least squares (St, Set) for the period
+   // Sh corrects the duty count at every Threshold3 crossing, from counting
+   // whole samples to the time spent below Threshold3 between samples
+   // the histogram and extremes give the pulse levels, Pulse_Measure takes
+   // their crossings for rise/fall time and widths
+   memset(&Scratch.Pulse, 0, sizeof(Scratch.Pulse));
+   n = g1 + Linear_Run(g1, g2 - g1, &q);
+   p = q;
+   u = *p;
+   for (i = g1; i < g2; p = Scan_Buffer, n = g2)
    {
-      j = (i + tp_to_abs);
-      if (j >= BUFFER_SIZE) j -= BUFFER_SIZE;
-
-      Vk += Scan_Buffer[j];
-      if ((i >= t0) && (i < t0 + 300))
+      for (; i < n; i++, u = v)
       {
-         if (Scan_Buffer[j] < t_max)
-            t_max = Scan_Buffer[j];
-         if (Scan_Buffer[j] > t_min)
-            t_min = Scan_Buffer[j];
-      }
-      if ((Trig == 0) && (Scan_Buffer[j] > Threshold1))
-         Trig = 1;
+         v = *p++;
 
-      if ((Trig == 1) && (Scan_Buffer[j] < Threshold2))
-      {
-         Trig = 0;
-         if (First_Edge == 0)
+         if ((v < Threshold3) != (u < Threshold3))
          {
-            First_Edge = i;
-            Last_Edge = i;
-            Edge = 0;
-         } else {
-            Last_Edge = i;
-            Edge++;
+            if (u < Threshold3)
+               Sh += (int)((Threshold3 - u) * 256 / (v - u)) - 256;
+            else
+               Sh += 256 - (int)((u - Threshold3) * 256 / (u - v));
          }
+
+         if ((Trig == 0) && (v > Threshold1))
+            Trig = 1;
+
+         if ((Trig == 1) && (v < Threshold2))
+         {
+            Trig = 0;
+            t = (i - 1) * 256 + (u - Threshold2) * 256 / (u - v);
+            if (First_Edge == 0)
+            {
+               First_Edge = i;
+               Last_Edge = i;
+               Edge = 0;
+               St = Set = 0;
+               First_T = t;
+               First_H = Sh - (i * 256 - t);
+            } else {
+               Last_Edge = i;
+               Edge++;
+            }
+            St += t;
+            Set += (unsigned long long)Edge * t;
+            Last_T = t;
+            Last_H = Sh - (i * 256 - t);
+         }
+
+         Scratch.Pulse.Hist[v >> 6]++;
+         Scratch.Pulse.HSum[v >> 6] += v;
+         if (v < Vlo) Vlo = v;
+         if (v > Vhi) Vhi = v;
       }
    }
-   Vk = Vk / BUFFER_SIZE;
+
+   // sum, min/max of the 300 displayed samples (or of the gate, as found by
+   // the pass) and duty count on sample runs
+   i = g2 - g1;
+   n = Linear_Run(g1, i, &q);
+   Vk = (Sum_Samples(q, n) + Sum_Samples(Scan_Buffer, i - n)) / i;
+   if (Item_Index[MEASURE_GATE]) {
+      t_max = Vlo;
+      t_min = Vhi;
+   } else {
+      i = (BUFFER_SIZE - t0 < 300) ? BUFFER_SIZE - t0 : 300;
+      n = Linear_Run(t0, i, &q);
+      MinMax_Samples(q, n, &t_max, &t_min);
+      MinMax_Samples(Scan_Buffer, i - n, &t_max, &t_min);
+   }
 
    MeFr = 0;
    if (Edge != 0)
    {
       MeFr = 1; // true
-      Vm = 0;
-      Vq = 0;
-      Vn = 0;
-      for (i = First_Edge; i < Last_Edge; i++)
-      {
-         j = (i + tp_to_abs);
-         if (j >= BUFFER_SIZE) j -= BUFFER_SIZE;
-
-         if (Scan_Buffer[j] < Threshold3) Vm++;
-
-         Vp = (4096 - Scan_Buffer[j]) - Threshold0;
-         Vn += (Vp * Vp) / 8;
-
-         if (Scan_Buffer[j] < Threshold0)
-            Vq += (Threshold0 - Scan_Buffer[j]);
-         else
-            Vq += (Scan_Buffer[j] - Threshold0);
-      }
-      if (Item_Index[X_SENSITIVITY] < 5)
-        Frequency = (Edge * (1000000000 / 1167) / (Last_Edge - First_Edge)) * 1000; // ??? suspicious, check
-      else
-        Frequency = (Edge * (1000000000 / T_Scale[Item_Index[X_SENSITIVITY]]) / (Last_Edge - First_Edge)) * 1000;
-
-      //Cycle = ((Last_Edge - First_Edge) * T_Scale[Item_Index[X_SENSITIVITY]]) / Edge;
-      //Tlow = ((Last_Edge - First_Edge - Vm) * T_Scale[Item_Index[X_SENSITIVITY]]) / Edge;
-      //Thigh = (Vm * T_Scale[Item_Index[X_SENSITIVITY]]) / Edge;
-      Duty = 100000 * Vm / (Last_Edge - First_Edge);
-
-      Vrms = ((Km[Item_Index[Y_SENSITIVITY]] * sqrt32(Vn / (Last_Edge - First_Edge) * 8)) / 4096)
-              * V_Scale[Item_Index[Y_SENSITIVITY]];
+      i = Last_Edge - First_Edge;
+      n = Linear_Run(First_Edge, i, &q);
+      Vm = Count_Below(q, n, Threshold3) + Count_Below(Scan_Buffer, i - n, Threshold3);
+      // exact sums of (v - Threshold0)^2 and |v - Threshold0| over whole cycles,
+      // V0 near the screen edges at high gain puts Threshold0 beyond 0..4095,
+      // Sum_Squares takes it as signed and clamps it exactly
+      Sq = 0;
+      Sn = Sum_Squares(q, n, Threshold0, &Sq) + Sum_Squares(Scan_Buffer, i - n, Threshold0, &Sq);
+
+      // least squares period of the Edge + 1 edge times, in 1/65536 sample:
+      // Tp = 12 * sum((e - mean) * t) / (n * (n * n - 1)) with n = Edge + 1
+      n = Edge + 1;
+      Tp = ((2 * Set - (unsigned long long)Edge * St) * 6 * 256) / ((unsigned long long)n * (n * n - 1));
+      // sample rate is 72MHz / ((PSC + 1) * (ARR + 1)), frequency in mHz
+      Frequency = (72000000000ULL * 65536) / (Tp * (Scan_PSC[Item_Index[X_SENSITIVITY]] + 1)
+                                                  * (Scan_ARR[Item_Index[X_SENSITIVITY]] + 1));
+
+      // time below Threshold3 over the interpolated First..Last edge span
+      Duty = (100000LL * (Vm * 256 + Last_H - First_H)) / (Last_T - First_T);
+
+      // rms of the i samples in 1/256 ADC step, Km / 4096 scales to pixels
+      Vrms = ((unsigned long long)Km[Item_Index[Y_SENSITIVITY]] * sqrt64((Sn << 16) / i)
+              * V_Scale[Item_Index[Y_SENSITIVITY]]) >> 20;
       Vrms = Vrms + Vrms * (Item_Index[CALIBRATE_RANGE] - 100) / 200;
-      Vavg = ((Km[Item_Index[Y_SENSITIVITY]] * (Vq / (Last_Edge - First_Edge))) / 4096)
-              * V_Scale[Item_Index[Y_SENSITIVITY]];
+      Vavg = ((unsigned long long)Km[Item_Index[Y_SENSITIVITY]] * Sq
+              * V_Scale[Item_Index[Y_SENSITIVITY]]) / ((unsigned int)i * 4096);
       Vavg = Vavg + Vavg * (Item_Index[CALIBRATE_RANGE] - 100) / 200;
 
-   }
+      Period = Sample_ns(Tp, 16);
+   } else
+      Period = NO_MEASURE;
+
+   Pulse_Measure(Vlo, Vhi, g1, g2);
 
    if (t_min < t_max) t_min = t_max;
 
@@ -614,6 +1077,16 @@ void      Measure_Wave(void)
    Vdc = (Tmp2 - Item_Index[V0]) * V_Scale[Item_Index[Y_SENSITIVITY]];
 
    MeDC = 1;
+
+   // waveform update rate, records measured over the last RATE_TIME ms or more
+   Rate_Frames++;
+   i = Rate_Time;
+   if (i >= RATE_TIME) {
+      Rate = (1000000ULL * Rate_Frames + i / 2) / i;
+      Rate_Frames = 0;
+      Rate_Time = 0;
+   }
+   Stat_Update();
    Update[MEASURE_KIND] = 1;
 
    if ((Item_Index[SYNC_MODE] == 4) && (Wait_CNT == 0))
@@ -657,121 +1130,849 @@ void      Measure_Wave(void)
    if (Wait_CNT > 5) Wait_CNT = 0;
    else Wait_CNT++;
 
-   Calculate_FFT();
+   FFT_Window();
 }
 
+/*******************************************************************************
+ Function Name : Counter_Arm
+ Description : wait for the next captured edge to open a new gate
+*******************************************************************************/
+static void Counter_Arm(void)
+{
+   Counter.Edges = 0;
+   Counter.Time = 0;
+   Counter.Over = 0;
+   Counter.State = CNT_ARM;
+}
 
 /*******************************************************************************
- Function Name : Calculate_FFT
- Description :  compute FFT with 64, 256 or 1024 bins
+ Function Name : Counter_Close
+ Description : end the gate from either interrupt. PA0 goes back to analog
+               input until Counter_Poll arms the next gate, edges that come
+               in the meantime are not counted anyway
+*******************************************************************************/
+static void Counter_Close(void)
+{
+   Counter.State = CNT_DONE;
+   GPIOA_CRL &= ~0x0000000F; // PA0 analog input, Schmitt trigger off
+}
 
+/*******************************************************************************
+ Function Name : Counter_Capture
+ Description : TIM2 interrupt work, sr is TIM2_SR and ccr the TIM2_CCR1 value
+               read with it. Timestamps count 72MHz ticks as overflows * Wrap
+               + ccr, the gate opens on the first edge and closes on the first
+               edge after Gate ms, so it always spans whole periods
 *******************************************************************************/
-void Calculate_FFT( void )
+void Counter_Capture(unsigned int sr, unsigned int ccr)
 {
-  unsigned short i, iback;
-  int FFT_Peakfreq, nyquist_freq;
-  I32STR_RES res; // Needed for string conversion
-  unsigned short factor;
+   unsigned int ovf = Counter.Ovf, ts;
+
+   if (sr & 0x0001) { // UIF, TIM2 wrapped
+      Counter.Ovf = ovf + 1;
+      if ((sr & 0x0002) && (ccr < Counter.Wrap / 2))
+         ovf++; // both pending, the capture was taken after the wrap
+   }
+   if ((sr & 0x0200) && (Counter.State == CNT_GATE)) { // CC1OF, an edge was lost
+      Counter.Over = 1;
+      Counter_Close();
+   }
+   if (!(sr & 0x0002)) return; // no CC1IF
+
+   ts = ovf * Counter.Wrap + ccr;
+   if (Counter.State == CNT_ARM) {
+      Counter.First = Counter.Last = ts;
+      Counter.Edges = 1;
+      Counter.Time = 0;
+      Counter.State = CNT_GATE;
+   } else if (Counter.State == CNT_GATE) {
+      Counter.Last = ts;
+      Counter.Edges++;
+      if (Counter.Time >= Counter.Gate) Counter_Close();
+   }
+}
+
+/*******************************************************************************
+ Function Name : Counter_Tick
+ Description : 1ms tick, closes the gate on the last edge seen when no further
+               edge arrives within CNT_TIMEOUT ms of the gate time. TIM2 has
+               the higher priority, a capture between the test of State and
+               the store of Time would open a gate with a stale Time or see
+               it closed at once, so the update runs with interrupts masked
+*******************************************************************************/
+void Counter_Tick(void)
+{
+   NVIC_SETPRIMASK();
+   if ((Counter.State == CNT_ARM) || (Counter.State == CNT_GATE))
+      if (++Counter.Time >= Counter.Gate + CNT_TIMEOUT) Counter_Close();
+   NVIC_RESETPRIMASK();
+}
+
+/*******************************************************************************
+ Function Name : Counter_Calc
+ Description : frequency (mHz) and period (ps, ns if Counter_TUnit) of the last
+               gate, returns 0 with both cleared when it held no whole period
+*******************************************************************************/
+unsigned char Counter_Calc(void)
+{
+   unsigned long long n, s, t;
+
+   Counter_Freq = Counter_Period = Counter_TUnit = 0;
+   s = Counter.Last - Counter.First; // modulo 2^32, 59s at 72MHz
+   if (Counter.Over || (Counter.Edges < 2) || (s == 0)) return 0;
+   n = (unsigned long long)(Counter.Edges - 1) << Counter.Psc; // whole periods
+
+   t = (n * 72000000000ULL + s / 2) / s;
+   Counter_Freq = (t > CNT_MAX) ? CNT_MAX : t;
+
+   t = (s * 125000 + n * 9 / 2) / (n * 9); // 1/72MHz = 125000/9 ps
+   if (t > CNT_MAX) {
+      t = (t + 500) / 1000;
+      Counter_TUnit = 1;
+   }
+   Counter_Period = t;
+   return 1;
+}
+
+/*******************************************************************************
+ Function Name : Counter_Start
+ Description : start the counter with gate time Gate_Time[g] or stop it (g = 0).
+               PA0 leaves analog mode while a gate is armed or open, so its
+               Schmitt trigger drives TIM2_CH1; the ADC keeps sampling the
+               same pin, whose analog path does not depend on the mode
+*******************************************************************************/
+void Counter_Start(unsigned char g)
+{
+   TIM2_DIER = 0; // CC1IE=0, UIE=0
+   Counter.State = CNT_IDLE;
+   Counter_Freq = Counter_Period = 0;
+   TIM2_CCER &= ~0x0001; // CC1E=0, CC1S is only writable with the channel off
+   if (g == 0) {
+      GPIOA_CRL &= ~0x0000000F; // PA0 analog input
+      return;
+   }
+   GPIOA_CRL = (GPIOA_CRL & ~0x0000000F) | 0x00000004; // PA0 floating input
+   Counter.Gate = Gate_Time[g];
+   Counter.Wrap = TIM2_ARR + 1;  // the timebase set up by the system
+   Counter.Psc = 0;
+   TIM2_CCMR1 = 0x0031;/*0000 0000 0011 0001
+                         |||| |||| |||| ||++---CC1S=01, IC1 on TI1
+                         |||| |||| |||| ++-----IC1PSC=00
+                         |||| |||| ++++--------IC1F=0011, 8 samples at 72MHz
+                         ++++-++++-------------CH2 unused*/
+   TIM2_CCER |= 0x0001; // CC1E=1, CC1P=0 rising edge
+   Counter_Arm();
+   TIM2_SR = 0;
+   TIM2_DIER = 0x0003; // CC1IE=1, UIE=1
+}
+
+/*******************************************************************************
+ Function Name : Counter_Poll
+ Description : main loop part, publish a closed gate and arm the next one,
+               capturing every 8th edge while the signal is fast. PA0 turns
+               digital before the sums, so an edge its Schmitt trigger shows
+               on the switch is taken while the gate is still closed
+*******************************************************************************/
+void Counter_Poll(void)
+{
+   if (Counter.State != CNT_DONE) return;
+   GPIOA_CRL = (GPIOA_CRL & ~0x0000000F) | 0x00000004; // PA0 floating input
+   Counter_Calc();
+   if (Counter.Over || (Counter_Freq > CNT_FAST)) Counter.Psc = 3;
+   else if (Counter_Freq < CNT_FAST / 2) Counter.Psc = 0;
+   TIM2_CCMR1 = 0x0031 | (Counter.Psc << 2); // IC1PSC, divide by 1 or 8
+   Counter_Arm();
+   Update[COUNTER_GATE] = 1;
+}
 
-  // STEP 0 : Erase previous fft screen
-  Erase_FFT();
+/*******************************************************************************
+ Function Name : Cos_Step
+ Description :  cos(2 PI q / 1024) from the quarter wave table, 1.0 = 32768
+*******************************************************************************/
+static int Cos_Step(unsigned short q)
+{
+  q &= 1023;
+  switch (q >> 8) {   // quadrant
+    case 0:  return  Cos_Table[q];
+    case 1:  return -Cos_Table[512 - q];
+    case 2:  return -Cos_Table[q - 512];
+    default: return  Cos_Table[1024 - q];
+  }
+}
 
+/*******************************************************************************
+ Function Name : Cosine
+ Description :  cos(2 PI q / FFT_PHASE), 1.0 = 32768. The low 6 bits of q
+                interpolate between two table steps, within 2 LSB
+*******************************************************************************/
+static int Cosine(unsigned short q)
+{
+  int a = Cos_Step(q >> 6);
 
-  // STEP 1 : Get data from Scan_Buffer
-  for ( i = 0; i < NP; i++ )
+  if (q & 63) a += ((Cos_Step((q >> 6) + 1) - a) * (q & 63) + 32) >> 6;
+  return a;
+}
+
+/*******************************************************************************
+ Function Name : Window
+ Description :  window weight at phase p, FFT_PHASE steps per period, 1.0 = 32768
+*******************************************************************************/
+static int Window(short const *c, unsigned short p)
+{
+  int w = c[0], m;
+
+  for (m = 1; (m < 5) && c[m]; m++)
+    w += (c[m] * Cosine((m * p) & (FFT_PHASE - 1))) >> 15;
+  return w;
+}
+
+/*******************************************************************************
+ Function Name : Real_Spectrum
+ Description :  turn Z, the m point complex FFT in f of the packed pairs z[i]
+                = x[2i] + j x[2i + 1], into FFT_mag, the magnitudes of bins
+                0 .. m - 1 of the 2m point real FFT of x. With A = Z[k], B =
+                conj Z[m - k], E = A + B, O = (A - B) / j and W = e^(-j PI k
+                / m): 2 X[k] = E + W O and 2 X[m - k] = conj(E - W O). Z of
+                the 14 bit input stays well inside 2^14, so W O fits 32 bit.
+                f may be FFT_mag itself, bins k and m - k are read first
+*******************************************************************************/
+static void Real_Spectrum(const int *f, unsigned short m)
+{
+  unsigned short k;
+  int ar, ai, br, bi, er, ei, or, oi, tr, ti, c, s;
+
+  ar = (short)f[0];
+  ai = f[0] >> 16;
+  FFT_mag[0] = Magnitude(ar + ai, 0);  // DC, the Nyquist bin ar - ai is not kept
+  for (k = 1; k <= m / 2; k++)
   {
-    FFT_in[ i ] = Scan_Buffer[ t0 + i ]; // No need to scale 12-bit input value
+    ar = (short)f[k];
+    ai = f[k] >> 16;
+    br = (short)f[m - k];
+    bi = -(f[m - k] >> 16);
+    er = ar + br;
+    ei = ai + bi;
+    or = ai - bi;
+    oi = br - ar;
+    c = Cosine(k * (FFT_PHASE / 2 / m));
+    s = Cosine(k * (FFT_PHASE / 2 / m) - FFT_PHASE / 4);
+    tr = (c * or + s * oi + 0x4000) >> 15;    // W O with W = c - j s
+    ti = (c * oi - s * or + 0x4000) >> 15;
+    FFT_mag[k] = (Magnitude(er + tr, ei + ti) + 1) >> 1;
+    FFT_mag[m - k] = (Magnitude(er - tr, ei - ti) + 1) >> 1;
+  }
+}
+
+/*******************************************************************************
+ Function Name : FFT_Combine
+ Description :  join the four FFT_PART point transforms in FFT_in into the
+                FFT_MAX point one, in place. Quarter r holds Y_r, from the
+                points r, r + 4 .. With A_r = W^(rk) Y_r[k] and W = e^(-j 2 PI
+                / FFT_MAX), bin k + q FFT_PART is the sum over r of (-j)^(rq)
+                A_r, over 4 for the 1 / N scale of the library. A_r is kept
+                at 4 x, Y_r stays inside 2^14 so the products fit 32 bit
+*******************************************************************************/
+static void FFT_Combine(void)
+{
+  int *y = FFT_in;
+  int ar[4], ai[4], er, ei, fr, fi, gr, gi, hr, hi, c, s;
+  unsigned short k, p;
+  unsigned char r;
+
+  for (k = 0; k < FFT_PART; k++, y++)
+  {
+    ar[0] = (short)y[0] << 2;
+    ai[0] = (y[0] >> 16) << 2;
+    for (r = 1; r < 4; r++)
+    {
+      p = r * k * (FFT_PHASE / FFT_MAX);   // whole table steps, exact
+      c = Cosine(p);
+      s = Cosine(p - FFT_PHASE / 4);
+      ar[r] = ((short)y[r * FFT_PART] * c + (y[r * FFT_PART] >> 16) * s + 0x1000) >> 13;   // W = c - j s
+      ai[r] = ((y[r * FFT_PART] >> 16) * c - (short)y[r * FFT_PART] * s + 0x1000) >> 13;
+    }
+    er = ar[0] + ar[2];   // A0 + A2
+    ei = ai[0] + ai[2];
+    fr = ar[0] - ar[2];   // A0 - A2
+    fi = ai[0] - ai[2];
+    gr = ar[1] + ar[3];   // A1 + A3
+    gi = ai[1] + ai[3];
+    hr = ar[1] - ar[3];   // A1 - A3
+    hi = ai[1] - ai[3];
+    y[0] = (((ei + gi + 8) >> 4) << 16) | (((er + gr + 8) >> 4) & 0xffff);
+    y[FFT_PART] = (((fi - hr + 8) >> 4) << 16) | (((fr + hi + 8) >> 4) & 0xffff);       // - j
+    y[2 * FFT_PART] = (((ei - gi + 8) >> 4) << 16) | (((er - gr + 8) >> 4) & 0xffff);
+    y[3 * FFT_PART] = (((fi + hr + 8) >> 4) << 16) | (((fr - hi + 8) >> 4) & 0xffff);   // + j
   }
+}
+
+/*******************************************************************************
+ Function Name : Clamp16
+ Description :  x saturated to 16 bit signed
+*******************************************************************************/
+static int Clamp16(int x)
+{
+  return (x > 32767) ? 32767 : (x < -32768) ? -32768 : x;
+}
 
-  // STEP 2 : Hanning window function
-  // The multiplication factors are symmetrical
-  iback = NP - 1;
-  for ( i = 0; i < NP / 2; i++)
+/*******************************************************************************
+ Function Name : Zoom_Filter
+ Description :  the ZOOM_TAPS * d tap low pass in front of a decimation by d,
+                sin(PI t / d) / (PI t / d) under the Blackman-Harris window,
+                the taps at t = j - (ZOOM_TAPS * d - 1) / 2. It passes flat to
+                a quarter of the decimated rate and stops from three quarters
+                on, which is where what folds onto the passband comes from.
+                The DC gain is 2^g, 1.0 = 32768, g grows with d as the taps
+                get smaller and keeps them 16 bit. Returns g
+*******************************************************************************/
+static unsigned char Zoom_Filter(unsigned char d)
+{
+  short *h = Scratch.Zoom.Coef;
+  unsigned short j, n = ZOOM_TAPS * d;
+  unsigned char g;
+  int x, v, sum = 0;
+  long long y;
+
+  for (j = n / 2; j < n; j++)   // the upper half, mirrored
   {
-    // Hanning value between 0..65535 instead of 0..1
-    if (NP == 64) factor = Hanning64[i];
-    if (NP == 256) factor = Hanning256[i];
-    if (NP == 1024) factor = Hanning1024[i];
-    FFT_in[i]     = ( FFT_in[i]     * factor ) >> 16;
-    FFT_in[iback] = ( FFT_in[iback] * factor ) >> 16;
-    iback--;
+    x = 2 * j + 1 - n;          // 2 t, odd
+    v = Cosine((FFT_PHASE / 4 * x + d / 2) / d - FFT_PHASE / 4);   // sin(PI t / d)
+    v = (((v * 20861 / x) >> 4) * d) >> 11;                        // / (PI t / d), 20861 = 2 / PI
+    v = (v * Window(Win_Coef[ZOOM_WINDOW], FFT_PHASE / 2 * (2 * j + 1) / n)) >> 16;   // half, fits 16 bit
+    h[j] = h[n - 1 - j] = v;
+    sum += 2 * v;
   }
+  for (g = 0; (4 << g) <= d; g++);
+  for (j = 0; j < n; j++)
+  {
+    y = (long long)h[j] << (15 + g);
+    h[j] = (y + ((y < 0) ? -sum / 2 : sum / 2)) / sum;
+  }
+  return g;
+}
+
+/*******************************************************************************
+ Function Name : Zoom_Mix
+ Description :  the decimating mixer, blocks b .. b + nb - 1 of the frame.
+                Mix the copy FFT_Window took of the middle (m + ZOOM_TAPS -
+                1) * d samples down by the center frequency, low pass and
+                decimate them by d into m complex points, windowed, over the
+                FFT_MIX passes. Each block of d samples is mixed once and
+                then adds into the ZOOM_TAPS outputs that span it, output b -
+                a through the taps a * d .. a * d + d - 1. Samples go in
+                around the record mean and mixed to 2 x, the first block
+                builds the filter. A tone comes out at 4 x, as in the real
+                FFT. Output o goes to Fft.In below the copy once block o +
+                ZOOM_TAPS - 1 is read. Up to x8 the copy starts above all of
+                the output, at x16 each block read frees 16.5 bytes of the
+                copy against the 4 of an output
+*******************************************************************************/
+static void Zoom_Mix(unsigned short b, unsigned short nb)
+{
+  short u[ZOOM_DEC_MAX], v[ZOOM_DEC_MAX];   // the block, mixed to I and Q
+  short const *h, *c = Win_Coef[Item_Index[FFT_WINDOW]];
+  short *x = (short *)FFT_in;               // ST library format, I then Q of each point
+  int *acc = Scratch.Zoom.Acc;              // output o sums in acc[2 * (o % ZOOM_TAPS)]
+  const unsigned char *rec;
+  unsigned short o, j, m = FFT_Job.M;
+  unsigned char a, a1, a2, k, r, d = Zoom_Dec[FFT_Job.Zoom], g;
+  unsigned int ph, w = Item_Index[FFT_CENTER] * (0x80000000U / (FFT_CENTER_FS / 2));  // NCO, 2^32 per period
+  int s, si, sq, f;
+
+  if (b == 0)
+  {
+    FFT_Job.Gain = Zoom_Filter(d);
+    memset(acc, 0, sizeof(Scratch.Zoom.Acc));
+  }
+  g = FFT_Job.Gain;
+  rec = ZOOM_REC((m + ZOOM_TAPS - 1) * d);
+  j = b * d;
+  ph = j * w;
+  for (nb += b; b < nb; b++)
+  {
+    for (r = 0; r < d; r++, j++, ph += w)
+    {
+      s = Packed(rec, j) - FFT_Job.Mean;
+      u[r] = (s * Cosine(ph >> 16) + 0x2000) >> 14;            // s e^(-j ph), rounded, a
+      v[r] = (0x2000 - s * Cosine((ph >> 16) - FFT_PHASE / 4)) >> 14;  // bias would show at the center
+    }
+    a1 = (b >= m) ? b - m + 1 : 0;   // outputs b - a inside 0 .. m - 1
+    a2 = (b < ZOOM_TAPS - 1) ? b : ZOOM_TAPS - 1;
+    k = (b - a1) % ZOOM_TAPS;
+    for (a = a1; a <= a2; a++)
+    {
+      h = Scratch.Zoom.Coef + a * d;
+      for (si = sq = 0, r = 0; r < d; r++)
+      {
+        si += h[r] * u[r];
+        sq += h[r] * v[r];
+      }
+      acc[2 * k] += si;
+      acc[2 * k + 1] += sq;
+      k = k ? k - 1 : ZOOM_TAPS - 1;
+    }
+    if (b >= ZOOM_TAPS - 1)   // output b - ZOOM_TAPS + 1 has all its taps
+    {
+      o = b - (ZOOM_TAPS - 1);
+      k = o % ZOOM_TAPS;
+      f = Window(c, o * (FFT_PHASE / m)) >> 1;
+      x[2 * o] = Clamp16((((acc[2 * k] + (0x1000 << g)) >> (13 + g)) * f + 0x2000) >> 14);
+      x[2 * o + 1] = Clamp16((((acc[2 * k + 1] + (0x1000 << g)) >> (13 + g)) * f + 0x2000) >> 14);
+      acc[2 * k] = acc[2 * k + 1] = 0;
+    }
+  }
+}
+
+/*******************************************************************************
+ Function Name : Window_Input
+ Description :  window the n real samples FFT_Window copied to FFT_in, in
+                place. The window is symmetric so each value serves sample i
+                and sample n - i. Samples are taken around mid scale and gain
+                4, so the 16 bit input holds 14 bits even under the flat top
+                window. The largest FFT has them by FFT_SLOT
+*******************************************************************************/
+static void Window_Input(unsigned short n)
+{
+  short const *c = Win_Coef[Item_Index[FFT_WINDOW]];
+  short *x = (short *)FFT_in;
+  unsigned short i, a, b;
+  unsigned char q4 = n > 2 * FFT_PART;
+  int f;
+
+  for (i = 0; i <= n / 2; i++)
+  {
+    f = Window(c, i * (FFT_PHASE / n));
+    a = q4 ? FFT_SLOT(i) : i;
+    x[a] = (x[a] * f) >> FFT_SHIFT;
+    if ((i > 0) && (i < n / 2))
+    {
+      b = q4 ? FFT_SLOT(n - i) : n - i;
+      x[b] = (x[b] * f) >> FFT_SHIFT;
+    }
+  }
+}
+
+/*******************************************************************************
+ Function Name : Zoom_Spectrum
+ Description :  magnitudes of the h bins either side of the center of an m
+                point complex FFT: FFT_mag[i] is bin i - h for i = 0 .. 2h - 1
+*******************************************************************************/
+static void Zoom_Spectrum(unsigned short m, unsigned short h)
+{
+  unsigned short i;
+
+  for (i = 0; i < h; i++)   // bins 0 .. h - 1
+    FFT_mag[h + i] = Magnitude((short)FFT_out[i], FFT_out[i] >> 16);
+  for (i = 0; i < h; i++)   // bins -h .. -1
+    FFT_mag[i] = Magnitude((short)FFT_out[m - h + i], FFT_out[m - h + i] >> 16);
+}
+
+/*******************************************************************************
+ Function Name : Cos32
+ Description :  cos(2 PI p / 2^32), 1.0 = 32768, Cosine interpolated by bits
+                8 .. 15 of the phase
+*******************************************************************************/
+static int Cos32(unsigned int p)
+{
+  int a = Cosine(p >> 16);
+
+  return a + (((Cosine((p >> 16) + 1) - a) * (int)((p >> 8) & 0xff) + 128) >> 8);
+}
+
+/*******************************************************************************
+ Function Name : Tone_Setup
+ Description :  phase step and coefficients of each tone of the set at the
+                sample rate, 72MHz / ((PSC + 1) * (ARR + 1)), and a cleared
+                resonator. Tones within 2 record bins of 0 or half the sample
+                rate are left out. 2 cos(w) comes as 2 - 4 sin(w / 2)^2,
+                which keeps its precision down at the low tones
+*******************************************************************************/
+static void Tone_Setup(void)
+{
+  unsigned long long m, d = (unsigned long long)(Scan_PSC[Item_Index[X_SENSITIVITY]] + 1)
+                            * (Scan_ARR[Item_Index[X_SENSITIVITY]] + 1);
+  unsigned char k, set = Item_Index[TONE_SET];
+  ToneType *t = Tone;
+  int s;
 
-  // STEP 3 : Call the ST library
-  for (i=0; i < NP; i++)
+  for (k = 0; k < N_TONE; k++, t++)
   {
-    FFT_in[i] = (FFT_in[i]) << 16 ;
+    if (set < N_TONE_SET - 1) {
+      m = Tone_Hz[set][k] * d;   // 72MHz times the tone over the sample rate
+      m = (m < 36000000) ? (m << 32) / 72000000 : 0;
+    } else
+      m = (unsigned long long)(k + 1) * Item_Index[FFT_CENTER] * (0x100000000ULL / FFT_CENTER_FS);
+    t->W = ((m >= TONE_MIN) && (m <= 0x80000000ULL - TONE_MIN)) ? m : 0;
+    s = Cos32(t->W / 2 - 0x40000000);   // sin(w / 2)
+    t->C = (1LL << 30) - 2LL * s * s;
+    t->Sin = (2LL * s * Cos32(t->W / 2) + 0x4000) >> 15;
+    t->S1 = t->S2 = 0;
   }
-  if (NP == 64) cr4_fft_64_stm32(FFT_out, FFT_in, NP);
-  if (NP == 256) cr4_fft_256_stm32(FFT_out, FFT_in, NP);
-  if (NP == 1024) cr4_fft_1024_stm32(FFT_out, FFT_in, NP);
+}
 
-  powerMag(NP, "1SIDED");
-  Draw_FFT();
+/*******************************************************************************
+ Function Name : Tone_Run
+ Description :  feed record samples i .. i + n - 1 from the copy in Tone_Rec
+                through the resonators, S = x + 2 cos(w) S1 - S2. The samples
+                go in around the record mean, windowed over the whole record.
+                They stay within 2400, and the gain of a resonator is at most
+                1 / sin(w), 245 at 2 bins, so after BUFFER_SIZE samples S
+                still fits 31 bit
+*******************************************************************************/
+static void Tone_Run(unsigned short i, unsigned short n)
+{
+  short const *c = Win_Coef[Item_Index[FFT_WINDOW]];
+  ToneType *t;
+  int x, s;
 
-  // Find the peak frequency
-  FFT_Peakfreq = 0;
-  int binmax=0;
-  for (i=2; i < NP / 2; i++)
+  for (; n; n--, i++)
   {
-    if (FFT_Peakfreq < FFT_out[i])
+    x = (((Packed(Tone_Rec, i) - FFT_Job.Mean) * Window(c, i * FFT_PHASE / BUFFER_SIZE))
+         + (1 << (TONE_SHIFT - 1))) >> TONE_SHIFT;
+    for (t = Tone; t < Tone + N_TONE; t++)
     {
-      FFT_Peakfreq = FFT_out[i] ;
-      binmax = i;
+      if (!t->W) continue;
+      s = x + (int)(((long long)t->C * t->S1 + (1 << 28)) >> 29) - t->S2;
+      t->S2 = t->S1;
+      t->S1 = s;
     }
   }
-  nyquist_freq = (1000000000 / T_Scale[Item_Index[X_SENSITIVITY]]); // in Hz
-  FFT_Peakfreq = (nyquist_freq / (NP - 1)) * binmax; // in Hz
+}
 
-  Int32String( &res, FFT_Peakfreq, 4 );
-  DisplayFieldEx( 6, REF_COLOR, "",  (unsigned const char*) res.str, F_Unit_DUPLICATE[res.decPos]);
+/*******************************************************************************
+ Function Name : Tone_Levels
+ Description :  level of each tone once the record is through, from the
+                Goertzel output X = S1 - S2 e^(-jw). The window takes the
+                samples in at 1/8 on average, a tone of amplitude A gives
+                |X| = A BUFFER_SIZE / 16. Vtone is the rms of the tone
+                Item_Index[TONE_PICK] names, or of the strongest at 0.
+                Returns the index of that tone, N_TONE when it is not in the
+                band
+*******************************************************************************/
+static unsigned char Tone_Levels(void)
+{
+  ToneType *t = Tone;
+  unsigned char k, top = N_TONE;
+  long long re, im;
+  unsigned int x;
 
+  Vtone = NO_MEASURE;
+  for (k = 0; k < N_TONE; k++, t++)
+  {
+    t->Rms = t->Bar = 0;
+    if (!t->W) continue;
+    re = t->S1 - (((long long)t->C * t->S2 + (1 << 29)) >> 30);
+    im = ((long long)t->Sin * t->S2 + 0x4000) >> 15;
+    x = sqrt64(re * re + im * im);
+    t->Rms = ((unsigned long long)x * 11585 + 2 * BUFFER_SIZE) / (4 * BUFFER_SIZE);   // 11585 / 4 = 4096 / sqrt(2)
+    x = (32 * x + BUFFER_SIZE / 2) / BUFFER_SIZE;   // 2 A, FFT_FS at full scale
+    t->Bar = (x > 0xffff) ? 0xffff : x;
+    if ((top == N_TONE) || (t->Rms > Tone[top].Rms)) top = k;
+  }
+  if (Item_Index[TONE_PICK]) {
+    top = Item_Index[TONE_PICK] - 1;
+    if (!Tone[top].W) top = N_TONE;
+  }
+  if (top < N_TONE) {
+    // as Vrms, Km / 4096 scales to pixels
+    Vtone = ((unsigned long long)Km[Item_Index[Y_SENSITIVITY]] * Tone[top].Rms
+             * V_Scale[Item_Index[Y_SENSITIVITY]]) >> 20;
+    Vtone = Vtone + Vtone * (Item_Index[CALIBRATE_RANGE] - 100) / 200;
+  }
+  return top;
 }
 
+/*******************************************************************************
+ Function Name : FFT_Window
+ Description :  first FFT stage, run as the capture completes and the only one
+                that reads the record. Takes the settings of the frame and
+                copies what the view needs, the ADC restarts right after and
+                FFT_Step does the rest. The plain FFT takes the n real samples
+                of Item_Index[FFT_SIZE], to go in pairs through an n / 2
+                point complex FFT. Zoomed, Item_Index[FFT_ZOOM] sets the
+                transform instead and the view is 1 / 2^zoom of the sample
+                rate around the center. THD and the harmonic view need the
+                plain FFT, the harmonic view turns the zoom off. The tone
+                detector takes the whole record. Nothing when the view is off
+*******************************************************************************/
+void FFT_Window(void)
+{
+  unsigned short i, j, k, l, n = FFT_Size[Item_Index[FFT_SIZE]];
+  unsigned char z = Item_Index[FFT_HARM] ? 0 : Item_Index[FFT_ZOOM], d = Zoom_Dec[z], q4;
+  short *x = (short *)FFT_in;
+
+  if (Item_Index[FFT_HARM] == FFT_VIEW_OFF)
+  {
+    Erase_FFT();  // bars left from before a profile turned it off
+    Thd = ThdN = Vtone = NO_MEASURE;
+    return;
+  }
+  FFT_Job.Pos = 0;
+  if (Item_Index[FFT_HARM] == FFT_VIEW_TONE)
+  {
+    // the resonators take a copy of the record in trigger order, FFT_SLICE
+    // samples a pass, the next capture refills Scan_Buffer meanwhile
+    FFT_Job.Mean = (Pack_Record(Tone_Rec, 0, BUFFER_SIZE) + BUFFER_SIZE / 2) / BUFFER_SIZE;
+    Tone_Setup();
+    FFT_Job.R = 256;  // the readout takes the tone phase step in 1/256 of the sample rate
+    Thd = ThdN = NO_MEASURE;
+    FFT_Job.Stage = FFT_TONE;
+    return;
+  }
+  Vtone = NO_MEASURE;
+  FFT_Job.Zoom = z;
+  FFT_Job.First = 2;
+  if (z)
+  {
+    // Mix the middle of the record down to m complex points at 1 / d of the
+    // sample rate, bin k is k / r of the sample rate from the center. The
+    // view takes the h bins either side, in the flat part of the low pass,
+    // and shows as r / 2^zoom points would over the full sample rate. The
+    // mixer takes a copy of the samples it needs and their mean
+    FFT_Job.Size = Zoom_Size[z];
+    FFT_Job.M = FFT_Size[Zoom_Size[z]] / 2;
+    FFT_Job.R = FFT_Job.M * d;
+    FFT_Job.H = FFT_Job.R >> (z + 2);
+    FFT_Job.N = FFT_Job.R >> z;
+    l = (FFT_Job.M + ZOOM_TAPS - 1) * d;
+    FFT_Job.Mean = (Pack_Record(ZOOM_REC(l), (BUFFER_SIZE - l) / 2, l) + l / 2) / l;
+
+    // the DC left after taking out the record mean, and its leakage, take
+    // the two bins from 0 Hz when the view reaches down there
+    k = Item_Index[FFT_CENTER] * FFT_Job.R / FFT_CENTER_FS - FFT_Job.H;   // view bin 0, bins above 0 Hz
+    FFT_Job.First = (k < 2) ? 2 - k : 0;
+    FFT_Job.Stage = FFT_MIX;
+    return;
+  }
 
-/** This routine is taken from the ST DSP example.
-  * @brief  Compute power magnitude of the FFT transform
-  * @param ill: length of the array holding power mag
-  *   : strPara: if set to "1SIDED", removes aliases part of spectrum (not tested)
-  * @retval : None
-  */
-void powerMag(int nfill, char* strPara)
+  // Copy the record from t0 on into the ST library format around mid scale,
+  // sample i is the real (even i) or imaginary (odd i) half of word i / 2,
+  // the largest FFT by FFT_SLOT. The record wraps at BUFFER_SIZE
+  FFT_Job.Size = Item_Index[FFT_SIZE];
+  FFT_Job.M = n / 2;
+  FFT_Job.R = FFT_Job.N = n;
+  FFT_Job.H = 0;
+  q4 = FFT_Job.M > FFT_PART;
+  for (i = 0, j = t0; i < n; i++)
+  {
+    x[q4 ? FFT_SLOT(i) : i] = Scan_Buffer[j] - 2048;
+    if (++j >= BUFFER_SIZE) j = 0;
+  }
+  FFT_Job.Stage = FFT_WEIGHT;
+}
+
+/*******************************************************************************
+ Function Name : FFT_Step
+ Description :  run the next stage of the frame FFT_Window took, one per main
+                loop pass
+*******************************************************************************/
+void FFT_Step(void)
 {
-  int lX, lY;
-  int i;
+  unsigned int Peak, FFT_Peakfreq;
+  unsigned long long k64;
+  unsigned short n;
+  unsigned char k = 0;
+  I32STR_RES res; // Needed for string conversion
 
-  for (i = 0; i < nfill; i++)
+  switch (FFT_Job.Stage)
   {
-    lX = (FFT_out[i] << 16) >> 16; /* Real */
-    lY = (FFT_out[i] >> 16);       /* Imag */
+  case FFT_TONE:
+    n = (BUFFER_SIZE - FFT_Job.Pos < FFT_SLICE) ? BUFFER_SIZE - FFT_Job.Pos : FFT_SLICE;
+    Tone_Run(FFT_Job.Pos, n);
+    FFT_Job.Pos += n;
+    if (FFT_Job.Pos == BUFFER_SIZE) FFT_Job.Stage = FFT_DRAW;
+    break;
+
+  case FFT_MIX:
+    n = FFT_Job.M + ZOOM_TAPS - 1 - FFT_Job.Pos;   // blocks left
+    if (n > FFT_SLICE / Zoom_Dec[FFT_Job.Zoom]) n = FFT_SLICE / Zoom_Dec[FFT_Job.Zoom];
+    Zoom_Mix(FFT_Job.Pos, n);
+    FFT_Job.Pos += n;
+    if (FFT_Job.Pos == FFT_Job.M + ZOOM_TAPS - 1) FFT_Job.Stage = FFT_TRANSFORM;
+    break;
+
+  case FFT_WEIGHT:
+    Window_Input(FFT_Job.N);
+    FFT_Job.Stage = FFT_TRANSFORM;
+    break;
+
+  case FFT_TRANSFORM:
+    if (FFT_Job.M <= FFT_PART)
+    {
+      FFT_Run[FFT_Job.Size](FFT_out, FFT_in, FFT_Job.M);
+      FFT_Job.Stage = FFT_SPECTRUM;
+      break;
+    }
+    // the next quarter, back over its input for FFT_Combine
+    FFT_Run[FFT_Job.Size](FFT_out, FFT_in + FFT_Job.Pos * FFT_PART, FFT_PART);
+    memcpy(FFT_in + FFT_Job.Pos * FFT_PART, FFT_out, sizeof(FFT_out));
+    if (++FFT_Job.Pos == 4) FFT_Job.Stage = FFT_COMBINE;
+    break;
+
+  case FFT_COMBINE:
+    FFT_Combine();
+    FFT_Job.Stage = FFT_SPECTRUM;
+    break;
+
+  case FFT_SPECTRUM:
+    // the bin magnitudes into FFT_mag, zoomed only the view
+    if (FFT_Job.Zoom) Zoom_Spectrum(FFT_Job.M, FFT_Job.H);
+    else Real_Spectrum((FFT_Job.M > FFT_PART) ? FFT_in : FFT_out, FFT_Job.M);
+    FFT_Job.Stage = FFT_DRAW;
+    break;
+
+  case FFT_DRAW:
+    // the peak frequency, bin k is k / r of the sample rate, zoomed from h
+    // bins below the center. Unzoomed it is the fundamental of the harmonic
+    // analysis. The tone detector shows the tone Vtone measures
+    if (Item_Index[FFT_HARM] == FFT_VIEW_TONE)
+    {
+      k = Tone_Levels();
+      Peak = (k < N_TONE) ? Tone[k].W >> 8 : 0;
+    }
+    else if (FFT_Job.Zoom)
     {
-      float X = (float) lX;
-      float Y = (float) lY;
-      float Mag = sqrt(X*X + Y*Y);
-      FFT_out[ i ]=((int)(Mag)) ;
+      Peak = FFT_Peak(FFT_Job.First ? FFT_Job.First : 1, 2 * FFT_Job.H - 2)
+             + Item_Index[FFT_CENTER] * (65536 / FFT_CENTER_FS) * FFT_Job.R - (FFT_Job.H << 16);
+      Thd = ThdN = NO_MEASURE;
     }
+    else
+    {
+      Peak = FFT_Peak(FFT_Job.First, FFT_Job.N / 2 - 2);
+      FFT_Harmonics(FFT_Job.N, Peak);
+    }
+    Erase_FFT();
+    Draw_FFT(FFT_Job.N, FFT_Job.First);
+    FFT_Job.Stage = FFT_IDLE;
+    if (k == N_TONE)
+    {
+      Update[TRIG_LEVEL] = 1;   // no tone in the band, the field goes back
+      break;
+    }
+
+    // show the peak, the sample rate is 72MHz / ((PSC + 1) * (ARR + 1)),
+    // frequency in mHz, rounded
+    k64 = (unsigned long long)FFT_Job.R * 65536 * (Scan_PSC[Item_Index[X_SENSITIVITY]] + 1) * (Scan_ARR[Item_Index[X_SENSITIVITY]] + 1);
+    FFT_Peakfreq = (Peak * 72000000000ULL + k64 / 2) / k64;
+
+    Int32String( &res, FFT_Peakfreq, 5 );
+    DisplayFieldEx( 6, REF_COLOR, "",  (unsigned const char*) res.str, C_Unit[res.decPos]);
+    break;
   }
+}
 
-  if (strPara == "1SIDED") onesided(nfill);
+/*******************************************************************************
+ Function Name : FFT_Finish
+ Description :  run what is left of the frame in flight, before anything else
+                takes the scratch block or the FFT settings change
+*******************************************************************************/
+void FFT_Finish(void)
+{
+  while (FFT_Job.Stage != FFT_IDLE) FFT_Step();
 }
 
+/*******************************************************************************
+ Function Name : FFT_Peak
+ Description :  largest bin from lo to hi, in 1/65536 bin. The fraction
+                is the vertex of a parabola through the log magnitudes of the
+                bin and its neighbours (Gaussian interpolation), corrected
+                for the window by Peak_Fix
+*******************************************************************************/
+unsigned int FFT_Peak(unsigned short lo, unsigned short hi)
+{
+  unsigned short i, k = lo;
+  int const *p = Peak_Fix[Item_Index[FFT_WINDOW]];
+  int a, b, c, d, x2, x4;
+
+  for (i = lo + 1; i <= hi; i++)
+    if (FFT_mag[i] > FFT_mag[k]) k = i;
+
+  a = Log2(FFT_mag[k - 1] | 1);
+  b = Log2(FFT_mag[k] | 1);
+  c = Log2(FFT_mag[k + 1] | 1);
+  d = 2 * b - a - c;                   // > 0 unless the three are level
+  if (d <= 0) return k << 16;
+  d = ((long long)(c - a) << 15) / d;  // vertex, -0.5..0.5 bin = +-32768
+  x2 = (d * d) >> 16;
+  x4 = (x2 * x2) >> 16;
+  d = (d * (p[0] + ((p[1] * x2) >> 16) + ((p[2] * x4) >> 16))) >> 12;
+  if (d > 32768) d = 32768;
+  if (d < -32768) d = -32768;
+  return (k << 16) + d;
+}
 
-/**
-  * @brief  Removes the aliased part of the spectrum (not tested)
-  * @param ill: length of the array holding power mag
-  * @retval : None
-  */
-void onesided(int nfill)
+/*******************************************************************************
+ Function Name : Lobe_Power
+ Description :  sum of the squared bin magnitudes from k - s to k + s, the
+                power of a tone at bin k when s covers the window main lobe
+*******************************************************************************/
+static unsigned long long Lobe_Power(unsigned short k, unsigned short s)
+{
+  unsigned long long p = 0;
+
+  for (k -= s, s = 2 * s + 1; s; s--, k++)
+    p += (unsigned long long)FFT_mag[k] * FFT_mag[k];
+  return p;
+}
+
+/*******************************************************************************
+ Function Name : Root_Ratio
+ Description :  sqrt(a / b) in 1/65536, both are scaled down until a fits
+                32 bit so the quotient keeps 32 fraction bits
+*******************************************************************************/
+static unsigned int Root_Ratio(unsigned long long a, unsigned long long b)
 {
-  int i;
+  while (a >> 32)
+  {
+    a >>= 1;
+    b >>= 1;
+  }
+  return b ? sqrt64((a << 32) / b) : 0xffffffff;
+}
 
-  FFT_out[0] = FFT_out[0];
-  FFT_out[nfill/2] = FFT_out[nfill/2];
-  for (i = 1; i < nfill / 2; i++)
+/*******************************************************************************
+ Function Name : FFT_Harmonics
+ Description :  THD and THD+N of the n point FFT with the fundamental at peak,
+                in 1/65536 bin, and the bar heights of Harm_Amp. A tone's
+                power is the sum over the main lobe of the window, a bin
+                either side per cosine term, so the window gain drops out of
+                the ratios. THD takes harmonics 2 .. N_HARM below the Nyquist
+                frequency, THD+N all power outside the Harm_Notch bins around
+                the fundamental and DC. Left at NO_MEASURE when the
+                fundamental is weak, the lobes would overlap or the window
+                leaks too far
+*******************************************************************************/
+static void FFT_Harmonics(unsigned short n, unsigned int peak)
+{
+  short const *c = Win_Coef[Item_Index[FFT_WINDOW]];
+  unsigned short s, t = Harm_Notch[Item_Index[FFT_WINDOW]], k, b, b1 = (peak + 32768) >> 16;
+  unsigned long long p, p1, ph = 0, pn = 0;
+  unsigned int a;
+
+  memset(Harm_Amp, 0, sizeof(Harm_Amp));
+  Thd = ThdN = NO_MEASURE;
+  for (s = 1; (s < 5) && c[s]; s++);   // lobe half width, bins
+  if ((b1 <= 2 * s) || (b1 + s >= n / 2) || (FFT_mag[b1] < HARM_MIN)) return;
+
+  p1 = Lobe_Power(b1, s);
+  for (k = 1; k <= N_HARM; k++)
   {
-    FFT_out[i] = FFT_out[i] + FFT_out[nfill-i];
-    FFT_out[nfill-i] = 0x0;
+    b = (k * peak + 32768) >> 16;
+    if (b + s >= n / 2) break;
+    p = Lobe_Power(b, s);
+    if (k > 1) ph += p;
+    a = ((unsigned long long)Root_Ratio(p, p1) * FFT_mag[b1] + 32768) >> 16;
+    Harm_Amp[k - 1] = (a > 0xffff) ? 0xffff : a;
   }
+  if (t == 0) return;
+  a = ((unsigned long long)Root_Ratio(ph, p1) * 100000 + 32768) >> 16;
+  Thd = (a > HARM_PCT_MAX) ? HARM_PCT_MAX : a;
+
+  if ((b1 <= 2 * t) || (b1 + t >= n / 2)) return;
+  for (b = t + 1; b < n / 2; b++)
+    pn += (unsigned long long)FFT_mag[b] * FFT_mag[b];
+  a = ((unsigned long long)Root_Ratio(pn - Lobe_Power(b1, t), p1) * 100000 + 32768) >> 16;
+  ThdN = (a > HARM_PCT_MAX) ? HARM_PCT_MAX : a;
 }
 
 
@@ -781,42 +1982,140 @@ void onesided(int nfill)
 *******************************************************************************/
 void Erase_FFT(void)
 {
-   unsigned short i;
-   for (i = 2; i < NP; i++) // BUG: start index should be 1
+   unsigned short c;
+
+   for (c = 0; c < FFT_COLS; c++)
    {
-      Erase_SEG( X_OFFSET + i, 1, FFT_out[i], REF_COLOR );
+      if (FFT_Bar[c]) Erase_SEG( X_OFFSET + c, 1, FFT_Bar[c], REF_COLOR );
+      FFT_Bar[c] = 0;
    }
 }
 
 /*******************************************************************************
- Function Name : Draw_FFT
- Description   : draw FFT bins on screen
-                 draw vertical lines with height FFT_in[i]
+ Function Name : FFT_Avg_Reset
+ Description   : restart the spectrum average or max hold with the next frame
 *******************************************************************************/
-void Draw_FFT(void)
+void FFT_Avg_Reset(void)
 {
-   unsigned short i;
+   FFT_Frames = 0;
+}
 
-#if 1
-   for (i = 2; i < NP; i++) // BUG: start index should be 1
-   {
-    Draw_SEG( X_OFFSET + i, 1, FFT_out[i], REF_COLOR );
+/*******************************************************************************
+ Function Name : FFT_Move_Center
+ Description   : move the zoom center by s columns of the view and keep the
+                 view between 0 and half the sample rate
+*******************************************************************************/
+void FFT_Move_Center(int s)
+{
+   unsigned char z = Item_Index[FFT_ZOOM];
+   int h = z ? (FFT_CENTER_FS / 4) >> z : 0;   // half the view
+   int c = Item_Index[FFT_CENTER] + s * ((FFT_CENTER_FS / 2 / FFT_COLS) >> z);
+
+   if (c > FFT_CENTER_FS / 2 - h) c = FFT_CENTER_FS / 2 - h;
+   if (c < h) c = h;
+   Item_Index[FFT_CENTER] = c;
+   FFT_Avg_Reset();
+}
+
+/*******************************************************************************
+ Function Name : FFT_Average
+ Description   : fold this frame's column magnitude h into the average of
+                 column c and return the average. The first N frames weigh
+                 1/1, 1/2 .. 1/N, from there exponential with 1/N or held
+*******************************************************************************/
+static unsigned int FFT_Average(unsigned short c, unsigned int h)
+{
+   unsigned char a = Item_Index[FFT_AVG];
+   unsigned int  n = FFT_Frames;
+   int           d;
+
+   if (h > 0xfff) h = 0xfff;    // full scale, keeps 1.0 = 16 in 16 bit
+   h <<= 4;
+   if (a == AVG_MAX) {
+      if ((n == 1) || (h > FFT_Avg[c])) FFT_Avg[c] = h;
+   } else if ((a != AVG_LIN) || (n <= FFT_Avg_N[a])) {
+      if (n > FFT_Avg_N[a]) n = FFT_Avg_N[a];
+      d = (int)h - FFT_Avg[c];
+      FFT_Avg[c] += d / (int)n;
+   }
+   return (FFT_Avg[c] + 8) >> 4;
+}
+
+/*******************************************************************************
+ Function Name : FFT_dBV_Top
+ Description   : set FFT_Top, the first 10 dBV step at or above the rms of a
+                 full scale sine at this V/Div, scaled as Vrms. Returns how
+                 far full scale lies below the top, 1.0 = 4096 in log2
+*******************************************************************************/
+static int FFT_dBV_Top(void)
+{
+   unsigned long long u;
+   int l, t;
+
+   // 1448 = 2048 / sqrt(2), the rms of a full scale sine in ADC counts, in uV
+   u = ((unsigned long long)Km[Item_Index[Y_SENSITIVITY]] * V_Scale[Item_Index[Y_SENSITIVITY]] * 1448) >> 12;
+   u = u + (long long)u * (Item_Index[CALIBRATE_RANGE] - 100) / 200;
+   if (u == 0) u = 1;   // -GND-
+   l = ((int)Log2((unsigned int)u) - (int)Log2(1000000)) * 602 / 4096;   // 1/100 dBV, 20 log10(2) = 6.02
+   t = (l > 0) ? (l + 999) / 1000 : -(-l / 1000);            // 10 dB steps, up
+   if (t * 10 != FFT_Top) {
+      FFT_Top = t * 10;
+      Update[FFT_SCALE] = 1;   // the readout of the top
    }
-#else
-   //other approach to avoid flickering (DOES NOT WORK YET!)
-   for (i = 1; i < HALF_N; i++)
+   return (t * 1000 - l) * 4096 / 602;
+}
+
+/*******************************************************************************
+ Function Name : Draw_FFT
+ Description   : draw the n / 2 bins of an n point FFT over FFT_COLS columns,
+                 a column shows the largest of its bins or repeats one bin.
+                 Bins below first are left out, they hold the DC level and
+                 its window leakage. The harmonic view draws Harm_Amp as
+                 N_HARM bars instead, the tone detector one bar per tone.
+                 Averaging works on the column magnitudes. On a dB scale the
+                 top of the grid is 0 dBFS and the log is taken once per
+                 column, of its largest bin
+*******************************************************************************/
+void Draw_FFT(unsigned short n, unsigned short first)
+{
+   unsigned short c, b, b2;
+   unsigned int h, k = FFT_dB_Rows[Item_Index[FFT_SCALE]], key;
+   int d, top = (Item_Index[FFT_SCALE] == FFT_DBV) ? FFT_dBV_Top() : 0;
+
+   // restart the average when the spectrum it holds no longer compares
+   key = Item_Index[X_SENSITIVITY] | (Item_Index[Y_SENSITIVITY] << 5) | (Item_Index[FFT_SIZE] << 10)
+         | (Item_Index[FFT_WINDOW] << 12) | (Item_Index[FFT_AVG] << 15) | (Item_Index[FFT_ZOOM] << 18)
+         | (Item_Index[FFT_HARM] << 21) | (Item_Index[TONE_SET] << 23);
+   if (key != FFT_Avg_Key) FFT_Frames = 0;
+   FFT_Avg_Key = key;
+   if (FFT_Frames < 0xffff) FFT_Frames++;
+
+   for (c = 0; c < FFT_COLS; c++)
    {
-     if ( FFT_out[i] > Ref_Buffer[i] )
-     { //new value is higher: draw line above
-       Draw_SEG( X_OFFSET + i, Ref_Buffer[i], FFT_out[i], REF_COLOR );
-     }
-     if ( FFT_out[i] < Ref_Buffer[i] )
-     { //new value is lower: erase line below
-       Erase_SEG( X_OFFSET + i, FFT_out[i], Ref_Buffer[i], REF_COLOR );
-     }
-     Ref_Buffer[i] = FFT_out[i];
+      if (Item_Index[FFT_HARM] == FFT_VIEW_HARM) {
+        b = c / HARM_COLS;
+        h = ((b < N_HARM) && (c % HARM_COLS < HARM_COLS * 2 / 3)) ? Harm_Amp[b] : 0;
+      } else if (Item_Index[FFT_HARM] == FFT_VIEW_TONE) {
+        h = (c % TONE_COLS < TONE_COLS * 2 / 3) ? Tone[c / TONE_COLS].Bar : 0;
+      } else {
+        b = c * n / (2 * FFT_COLS);
+        b2 = (c + 1) * n / (2 * FFT_COLS);
+        if (b2 <= b) b2 = b + 1;
+        if (b < first) b = first;
+        for (h = 0; b < b2; b++) {
+          d = (FFT_mag[b] > 0) ? FFT_mag[b] : 0;
+          if ((unsigned int)d > h) h = d;
+        }
+      }
+      if (Item_Index[FFT_AVG] != AVG_OFF) h = FFT_Average(c, h);
+      if (k && h) {
+        d = ((int)(Log2(FFT_FS) - Log2(h) + top) * (int)k) >> 20;   // rows below the top
+        h = (d < 0) ? MAX_Y : (d < Y_SIZE) ? MAX_Y - d : 0;
+      } else
+        h >>= 15 - FFT_SHIFT;   // linear, rows as without the input gain
+      FFT_Bar[c] = (h > MAX_Y) ? MAX_Y : h;
+      if (FFT_Bar[c]) Draw_SEG( X_OFFSET + c, 1, FFT_Bar[c], REF_COLOR );
    }
-#endif
 }
 
 /******************************** END OF FILE *********************************/
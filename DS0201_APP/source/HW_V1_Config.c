@@ -25,7 +25,7 @@ const APP_Interface APP_Offsets = {
 
 LIB_Interface *pLib;
 
-volatile unsigned short Refresh_Counter, Delay_Counter;
+volatile unsigned short Refresh_Counter, Delay_Counter, Measure_Counter;
 volatile unsigned char Key_Buffer;
 
 /*******************************************************************************
@@ -40,6 +40,12 @@ void      NVIC_Configuration(void)
   NVIC_InitStructure.NVIC_IRQChannelSubPriority = 1;
   NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
   NVIC_Init(&NVIC_InitStructure);
+
+  // frequency counter, must be served within one capture interval
+  NVIC_InitStructure.NVIC_IRQChannel = TIM2_IRQChannel;
+  NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
+  NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+  NVIC_Init(&NVIC_InitStructure);
 }
 
 /*******************************************************************************
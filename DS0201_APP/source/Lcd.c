@@ -10,6 +10,9 @@ File Name: lcd.c
 
 unsigned short frm_col = BACKGROUND;
 
+// glyph columns copied from the LIB font table, bit 0 is the top pixel row
+unsigned short Font_Cache[FONT_WORDS];
+
 /*******************************************************************************
  LCD_WR_REG: Set LCD Register  Input: Register addr., Data
 *******************************************************************************/
@@ -99,107 +102,131 @@ Description : draw the grid
 *******************************************************************************/
 void  Display_Grid(void)
 {
-   unsigned short  i, j;
-   short n;
-
-   // grid background + outside frame
-   Fill_Rectangle(MIN_X - 1, MIN_Y - 1, X_SIZE + 2, Y_SIZE + 2, BACKGROUND);
-
-   // horizontal frame
-   for (i = MIN_X; i <= MAX_X; i++) {
-      Point_SCR(i, MIN_Y);
-      Set_Pixel(GRD_COLOR);
-      Point_SCR(i, MAX_Y);
-      Set_Pixel(GRD_COLOR);
-     if ((((i - MIN_X) % 5) == 0) && (i != MIN_X) && (i != MAX_X)) {
-       for (n = 1; n <= 2; n++) {
-          Point_SCR(i, MIN_Y + n);
-          Set_Pixel(GRD_COLOR);
-          Point_SCR(i, MAX_Y - n);
-          Set_Pixel(GRD_COLOR);
-       }
-     }
-   }
+   Display_Grid_Area(MIN_X - 1, MIN_Y - 1, X_SIZE + 2, Y_SIZE + 2);
+}
+/*******************************************************************************
+Function Name : Display_Grid_Area
+Description : redraw the part of the grid inside a rectangle
+NOTE : the area is streamed column by column through one window, a pixel is
+       grid when the class bits of its row and of its column intersect
+*******************************************************************************/
+#define GRID_HFRAME 0x01  // top and bottom frame rows / all columns inside the frame
+#define GRID_HTICK  0x02  // frame tick and horizontal grid rows / every 5th column
+#define GRID_VDOT   0x04  // every 5th row / vertical grid and frame tick columns
+#define GRID_VFRAME 0x08  // all rows inside the frame / left and right frame columns
 
-   // vertical frame
-   for (j = MIN_Y + 1; j <= (MAX_Y - 1); j++) {
-      Point_SCR(MIN_X, j);
-      Set_Pixel(GRD_COLOR);
-      Point_SCR(MAX_X, j);
-      Set_Pixel(GRD_COLOR);
-     if (((j - MIN_Y) % 5) == 0) {
-       for (n = 1; n <= 2; n++) {
-          Point_SCR(MIN_X + n, j);
-          Set_Pixel(GRD_COLOR);
-          Point_SCR(MAX_X - n, j);
-          Set_Pixel(GRD_COLOR);
-       }
-     }
+void  Display_Grid_Area(short x0, short y0, short width, short height)
+{
+   static unsigned char Grid_Row[Y_SIZE + 2]; // row classes from MIN_Y - 1 to MAX_Y + 1
+   unsigned short  c = BACKGROUND, g = GRD_COLOR;
+   unsigned char   m;
+   short           i, j, x1, y1;
+
+   if (!Grid_Row[1]) {  // build the row pattern on first use
+      for (j = 0; j < Y_SIZE; j++) {
+         m = GRID_VFRAME;
+         if ((j == 0) || (j == Y_SIZE - 1)) m |= GRID_HFRAME;
+         if ((j == 1) || (j == 2) || (j == Y_SIZE - 2) || (j == Y_SIZE - 3)) m |= GRID_HTICK;
+         if (((j % 25) == 0) && (j >= 25) && (j <= Y_SIZE - 25)) m |= GRID_HTICK;
+         if ((j >= Y_SIZE / 2 - 1) && (j <= Y_SIZE / 2 + 1)) m |= GRID_HTICK;
+         if (((j % 5) == 0) && (j >= 5) && (j <= Y_SIZE - 5)) m |= GRID_VDOT;
+         Grid_Row[j + 1] = m;
+      }
    }
 
-   // horizontal grid lines
-   for (j = MIN_Y + 25; j <= (MAX_Y - 25 + 1); j += 25)
-   {
-      for (i = MIN_X + 5; i <= (MAX_X - 5 + 1); i += 5)
-      {
-         if (j == (MIN_Y + Y_SIZE / 2)) {
-           for (n = -1; n <= 1; n++) {
-             Point_SCR(i, j + n);
-             Set_Pixel(GRD_COLOR);
-           }
-         } else {
-           Point_SCR(i, j);
-           Set_Pixel(GRD_COLOR);
+   // clip to the grid background + outside frame, then use grid relative coordinates
+   x1 = x0 + width - 1;
+   y1 = y0 + height - 1;
+   if (x0 < MIN_X - 1) x0 = MIN_X - 1;
+   if (x1 > MAX_X + 1) x1 = MAX_X + 1;
+   if (y0 < MIN_Y - 1) y0 = MIN_Y - 1;
+   if (y1 > MAX_Y + 1) y1 = MAX_Y + 1;
+   if ((x0 > x1) || (y0 > y1)) return;
+
+   LCD_SET_WINDOW(x0, x1, y0, y1);
+   LDC_DATA_OUT = c;
+   y0 -= MIN_Y - 1;
+   y1 -= MIN_Y - 1;
+   for (i = x0 - MIN_X; i <= x1 - MIN_X; i++) {
+      m = 0;
+      if ((i >= 0) && (i < X_SIZE)) m = GRID_HFRAME;
+      if ((i == 0) || (i == X_SIZE - 1)) m |= GRID_VFRAME;
+      if (((i % 5) == 0) && (i >= 5) && (i <= X_SIZE - 5)) m |= GRID_HTICK;
+      if (((i % 25) == 0) && (i >= 25) && (i <= X_SIZE - 25)) m |= GRID_VDOT;
+      if ((i >= X_SIZE / 2 - 1) && (i <= X_SIZE / 2 + 1)) m |= GRID_VDOT;
+      if ((i == 1) || (i == 2) || (i == X_SIZE - 2) || (i == X_SIZE - 3)) m |= GRID_VDOT;
+
+      for (j = y0; j <= y1; j++) {
+         if (Grid_Row[j] & m) {
+            if (c != g) { c = g; LDC_DATA_OUT = c; }
+         } else if (c != BACKGROUND) {
+            c = BACKGROUND;
+            LDC_DATA_OUT = c;
          }
+         LCD_nWR_ACT();
       }
    }
-   // vertical grid lines
-   for (i = MIN_X + 25; i <= (MAX_X - 25 + 1); i += 25)
-   {
-      for (j = MIN_Y + 5; j <= (MAX_Y - 5 + 1); j += 5)
-      {
-         if (i == (MIN_X + X_SIZE / 2)) {
-           for (n = -1; n <= 1; n++) {
-             Point_SCR(i + n, j);
-             Set_Pixel(GRD_COLOR);
-           }
-         } else {
-           Point_SCR(i, j);
-           Set_Pixel(GRD_COLOR);
-         }
-      }
+   LCD_SET_WINDOW(LCD_X1, LCD_X2, LCD_Y1, LCD_Y2); // restore full screen
+}
+/*******************************************************************************
+Function Name : Mark_SEG
+Description : add or erase the rows y1..y2 of a vertical segment, no clipping
+*******************************************************************************/
+static void Mark_SEG(unsigned short x, short y1, short y2, char Mode, unsigned short Color)
+{
+   if (Mode == ADD) {
+      for (; y1 <= y2; y1++) __Add_Color(x, y1, Color);
+   } else {
+      for (; y1 <= y2; y1++) __Erase_Color(x, y1, Color);
    }
 }
 /*******************************************************************************
-Function Name : Draw_SEG
-Description : draw a vertical segment
-Para : x is the horizontal coordinate, |y1-y2| is the segment heigth, Color
+Function Name : Sort_SEG
+Description : order the ends of a segment and limit them to the grid,
+              returns 0 when there is nothing to draw
 *******************************************************************************/
-void Draw_SEG(unsigned short x, unsigned short y1, unsigned short y2, unsigned short Color)
+static char Sort_SEG(unsigned short *y1, unsigned short *y2)
 {
-   unsigned short  j, clip = 0;
+   if (*y1 == 0xff) *y1 = *y2;
+   if (*y2 == 0xff) *y2 = *y1;
+   if (*y1 == 0xff) return 0;
 
-   if (y1 == 0xff) y1 = y2;
-   if (y2 == 0xff) y2 = y1;
-   if (y1 == 0xff) return;
-
-   if (y1 > y2)
+   if (*y1 > *y2)
    {
-      unsigned short t = y2;
-      y2 = y1;
-      y1 = t;
+      unsigned short t = *y2;
+      *y2 = *y1;
+      *y1 = t;
    }
-   if (y2 >= MAX_Y)
-      y2 = MAX_Y - 1;
-   if (y1 <= MIN_Y)
-      y1 = MIN_Y + 1;
+   if (*y2 >= MAX_Y)
+      *y2 = MAX_Y - 1;
+   if (*y1 <= MIN_Y)
+      *y1 = MIN_Y + 1;
+   return 1;
+}
+/*******************************************************************************
+Function Name : Clip_SEG
+Description : add or erase a segment around the popup, the popup rows are
+              clipped once per column instead of once per pixel
+*******************************************************************************/
+static void Clip_SEG(unsigned short x, unsigned short y1, unsigned short y2, char Mode, unsigned short Color)
+{
+   if (!Sort_SEG(&y1, &y2)) return;
 
    x += MIN_X;
-   if (Popup.Active && (x >= Popup.x) && (x < (Popup.x + Popup.width))) clip = 1;
-   for (j = y1; j <= y2; j++) {
-      if (clip && (j >= Popup.y) && (j < (Popup.y + Popup.height))) continue;
-      __Add_Color(x, j, Color);
-   }
+   if (Popup.Active && (x >= Popup.x) && (x < (Popup.x + Popup.width))) {
+      Mark_SEG(x, y1, (y2 < Popup.y) ? y2 : Popup.y - 1, Mode, Color);
+      Mark_SEG(x, (y1 >= Popup.y + Popup.height) ? y1 : Popup.y + Popup.height, y2, Mode, Color);
+   } else
+      Mark_SEG(x, y1, y2, Mode, Color);
+}
+/*******************************************************************************
+Function Name : Draw_SEG
+Description : draw a vertical segment
+Para : x is the horizontal coordinate, |y1-y2| is the segment heigth, Color
+*******************************************************************************/
+void Draw_SEG(unsigned short x, unsigned short y1, unsigned short y2, unsigned short Color)
+{
+   Clip_SEG(x, y1, y2, ADD, Color);
 }
 /*******************************************************************************
 Function Name : Erase_SEG
@@ -207,30 +234,22 @@ Description : use the Color to erase one line segment
 *******************************************************************************/
 void Erase_SEG(unsigned short x,unsigned short y1,unsigned short y2,unsigned short Color)
 {
-   unsigned short  j, clip = 0;
-
-   if (y1 == 0xff) y1 = y2;
-   if (y2 == 0xff) y2 = y1;
-   if (y1 == 0xff) return;
-
-   if (y1 > y2)
-   {
-      unsigned short t = y2;
-      y2 = y1;
-      y1 = t;
-   }
-   if (y2 >= MAX_Y)
-      y2 = MAX_Y - 1;
-   if (y1 <= MIN_Y)
-      y1 = MIN_Y + 1;
-
-   x += MIN_X;
-   if (Popup.Active && (x >= Popup.x) && (x < (Popup.x + Popup.width))) clip = 1;
-   for (j = y1; j <= y2; j++) {
-     if (clip && (j >= Popup.y) && (j < (Popup.y + Popup.height))) continue;
-     __Erase_Color(x, j, Color); //  erase the wave curve
-   }
+   Clip_SEG(x, y1, y2, ERASE, Color);
+}
+/*******************************************************************************
+Function Name : Popup_SEG
+Description : draw only the part of a vertical segment covered by the popup,
+              used to repair the area under a popup after it is closed
+*******************************************************************************/
+void Popup_SEG(unsigned short x, unsigned short y1, unsigned short y2, unsigned short Color)
+{
+   if (!Sort_SEG(&y1, &y2)) return;
+   if (y1 < Popup.y)
+      y1 = Popup.y;
+   if (y2 >= Popup.y + Popup.height)
+      y2 = Popup.y + Popup.height - 1;
 
+   Mark_SEG(x + MIN_X, y1, y2, ADD, Color);
 }
 /*******************************************************************************
 Function Name : Draw_Vt_Line
@@ -505,6 +524,19 @@ void Rounded_Rectangle(short x0, short y0, short width, short height, short Colo
   Set_Pixel(WHITE);
 }
 
+/*******************************************************************************
+Function Name : Init_Font
+Description : copy the 12 glyph rows of every character used by the APP from
+              the LIB font table, so strings are drawn without calls into LIB
+*******************************************************************************/
+void      Init_Font(void)
+{
+   unsigned short  i;
+
+   for (i = 0; i < FONT_WORDS; i++)
+      Font_Cache[i] = (pLib->Get_Font_8x14(FONT_FIRST + i / 8, i % 8) >> 2) & 0x0FFF;
+}
+
 /*******************************************************************************
 Function Name : Display_Str
 Description : print one string in the specific  position
@@ -512,29 +544,50 @@ Para : (x0,y0) is the coordinate of the start point of the string
        Color is the string color
        Mode=PRN Normal replace Display, Mode=INV Inverse replace Display
        s is the string
+NOTE: the whole string is streamed through one window, the data bus is only
+      written when the pixel color changes, blank columns are just clocked out
 *******************************************************************************/
 void      Display_Str(short x0, short y0, short Color, char Mode, unsigned const char *s)
 {
+   unsigned short  fg = Mode ? frm_col : Color;
+   unsigned short  bg = Mode ? Color : frm_col;
+   unsigned short  c = bg;
+   unsigned short const *g;
    short     i, j, b;
 
    LCD_SET_WINDOW(x0, LCD_X2, y0, y0 + 13);
+   LDC_DATA_OUT = bg;
    while (*s)
    {
-      b = 0;
+      g = ((*s >= FONT_FIRST) && (*s <= FONT_LAST)) ? &Font_Cache[(*s - FONT_FIRST) * 8] : 0;
       for (i = 0; i < 8; i++)
       {
-         if (*s >= 0x22)
-           b = pLib->Get_Font_8x14(*s, i);
-         for (j = 0; j < 12; j++)       //means the char height pixel
+         b = g ? g[i] : 0;
+         if (b)
          {
-            if (b & 4)
-              Set_Pixel(Mode?frm_col:Color);
-	    else
-              Set_Pixel(Mode?Color:frm_col);
-            b >>= 1;
+            for (j = 0; j < 12; j++)       //means the char height pixel
+            {
+               if (((b & 1) ? fg : bg) != c)
+               {
+                  c = (b & 1) ? fg : bg;
+                  LDC_DATA_OUT = c;
+               }
+               LCD_nWR_ACT();
+               b >>= 1;
+            }
+            if (c != bg)
+            {
+               c = bg;
+               LDC_DATA_OUT = c;
+            }
+            LCD_nWR_ACT();
+            LCD_nWR_ACT();
+         } else {
+            for (j = 0; j < 14; j++)       // blank column, background only
+            {
+               LCD_nWR_ACT();
+            }
          }
-         Set_Pixel(Mode?Color:frm_col);
-         Set_Pixel(Mode?Color:frm_col);
       }
       ++s; // the pointer of the string will add one
 
@@ -22,11 +22,23 @@ enum {
   MeDCV,
   MeVmin,
   MeVmax,
+  MeTone,
+  MeRise,
+  MeFall,
+  MePWidth,
+  MeNWidth,
+  MePeriod,
+  MeOvershoot,
+  MePreshoot,
+  MeThd,
+  MeThdN,
+  MeRate,
   VDiv,
   TDiv,
   TrigPosition,
   T1Cursor,
   T2Cursor,
+  MeasGate,
   V1Cursor,
   V2Cursor,
   GndPosition,
@@ -41,7 +53,20 @@ enum {
   SaveProfile,
   LoadProfile,
   OutFreq,
-  ProbeAtt
+  CntFreq,
+  CntPeriod,
+  ProbeAtt,
+  CalOffset,
+  CalRange,
+  MeasStats,
+  FftSize,
+  FftWindow,
+  FftScale,
+  FftAvg,
+  FftZoom,
+  FftCenter,
+  FftHarm,
+  FftTones
 } SubNames;
 
 const SubMenuType Sub[] = {
@@ -53,11 +78,23 @@ const SubMenuType Sub[] = {
   {"DC V", 0, MEASURE_KIND},
   {"Vmin", 0, MEASURE_KIND},
   {"Vmax", 0, MEASURE_KIND},
+  {"Tone", 0, MEASURE_KIND},
+  {"Rise", 1, MEASURE_KIND},
+  {"Fall", 0, MEASURE_KIND},
+  {"+Width", 0, MEASURE_KIND},
+  {"-Width", 0, MEASURE_KIND},
+  {"Period", 0, MEASURE_KIND},
+  {"Overshoot", 0, MEASURE_KIND},
+  {"Preshoot", 0, MEASURE_KIND},
+  {"THD", 0, MEASURE_KIND},
+  {"THD+N", 0, MEASURE_KIND},
+  {"Wfm Rate", 0, MEASURE_KIND},
   {"V/Div", 1, Y_SENSITIVITY},
   {"T/Div", 1, X_SENSITIVITY},
   {"Trig Pos", 1, TRIG_POS},
   {"T1 Cursor", 0, T1_CURSOR},
   {"T2 Cursor", 0, T2_CURSOR},
+  {"Meas Gate", 0, MEASURE_GATE},
   {"V1 Cursor", 1, V1_CURSOR},
   {"V2 Cursor", 0, V2_CURSOR},
   {"Gnd Pos", 0, GND_POSITION},
@@ -72,9 +109,21 @@ const SubMenuType Sub[] = {
   {"Save Pro", 0, SAVE_PROFILE},
   {"Load Pro", 0, LOAD_PROFILE},
   {"Out Freq", 1, OUTPUT_FREQUENCY},
+  {"Counter F", 0, COUNTER_GATE},
+  {"Counter T", 0, COUNTER_GATE},
   {"Probe Att", 1, INPUT_ATTENUATOR},
   {"Cal Offs", 0, CALIBRATE_OFFSET},
-  {"Cal Range", 0, CALIBRATE_RANGE}
+  {"Cal Range", 0, CALIBRATE_RANGE},
+  {"Stats", 0, MEASURE_STATS},
+  {"FFT Size", 1, FFT_SIZE},
+  {"Window", 0, FFT_WINDOW},
+  {"Scale", 0, FFT_SCALE},
+  {"Average", 0, FFT_AVG},
+  {"Zoom", 0, FFT_ZOOM},
+  {"Center", 0, FFT_CENTER},
+  {"View", 0, FFT_HARM},
+  {"Tones", 0, TONE_SET},
+  {"Tone Lvl", 0, TONE_PICK}
 };
 
 MainMenuType Menu[] = {
@@ -84,9 +133,11 @@ MainMenuType Menu[] = {
   {"XA", "X-axis", TrigPosition},
   {"TR", "Trigger", TrigMode},
   {"ME", "Measure", MeFreq},
+  {"PU", "Pulse", MeRise},
   {"FI", "File", SaveImage},
   {"FR", "Freq", OutFreq},
-  {"OT", "Other", ProbeAtt}
+  {"OT", "Other", ProbeAtt},
+  {"FT", "FFT", FftSize}
 };
 
 enum {
@@ -99,9 +150,17 @@ enum {
   TrigLevelF,
   DeltaVoltageF,
   DeltaTimeF,
-  InfoF
+  InfoF,
+  TableF      // N_MEASURE cells of the measure table, MeFreq order
 } FieldNames;
 
+// measure table, drawn in the popup area at the top left of the grid
+#define TABLE_X  (MIN_X + 8)
+#define TABLE_Y  (MAX_Y - 8 - TABLE_H)
+#define TABLE_W  204   // two columns of 96 px cells
+#define TABLE_H  166   // ten 16 px rows
+#define CELL(c, r) {TABLE_X + 4 + (c) * 100, TABLE_Y + TABLE_H - 4 - 14 - (r) * 16, 96}
+
 const FieldType Field[] = {
   {2, MAX_Y + 4, 40-2}, // SyncMode
   {40, MAX_Y + 4, 16}, // TriggerKind
@@ -112,7 +171,13 @@ const FieldType Field[] = {
   {2, 3, 80-2}, // TrigLevel
   {80, 3, 80}, // DeltaVoltage
   {160, 3, 80}, // DeltaTime
-  {240, 3, 80}  // Info
+  {240, 3, 80}, // Info
+  CELL(0, 0), CELL(0, 1), CELL(0, 2), CELL(0, 3), // Freq, Duty, Vrms, Vavg
+  CELL(0, 4), CELL(0, 5), CELL(0, 6), CELL(0, 7), // Vpp, DCV, Vmin, Vmax
+  CELL(0, 8),                                     // Tone
+  CELL(1, 0), CELL(1, 1), CELL(1, 2), CELL(1, 3), // Rise, Fall, +Width, -Width
+  CELL(1, 4), CELL(1, 5), CELL(1, 6), CELL(1, 7), // Period, Overshoot, Preshoot, THD
+  CELL(1, 8), CELL(0, 9)                          // THD+N, Wfm Rate
 };
 
 PopupType Popup;
@@ -179,19 +244,36 @@ unsigned const int Fout_ARR[16] = // frequency division factors
 
 //------------------------------------------ initial value definition------------------------------------------------
 
-unsigned short  Item_Index[27] = {0, 6, 7, 80, 0, 4, 8, 0, 0, 1, 1, 9, 233, 68, BUFFER_SIZE, 0, 0, 40, 199, 140, 0, 0, 1, 1, 1, 100, 100};
+unsigned short  Item_Index[N_ITEM] = {0, 6, 7, 80, 0, 4, 8, 0, 0, 1, 1, 9, 233, 68, BUFFER_SIZE, 0, 0, 40, 199, 140, 0, 0, 1, 1, 1, 100, 100, 0, 0, 0, 1, 1, 0, 0, 0, FFT_CENTER_FS / 4, 0, 0, 0};
 
 //hide or view the item, 1 means hide
-unsigned char   Hide_Index[27] = {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+unsigned char   Hide_Index[N_ITEM] = {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1};
+
+//if the item needs refresh, bit x set means refresh item x (see Update[] in Menu.h)
+volatile unsigned int   Update_Mask[2];
 
-//if the item needs refresh, 1 means refresh
-volatile unsigned char  Update[27];
+// last text and color painted into each field as prefix 1 string 2 suffix
+unsigned char   Field_Text[N_FIELD][16];
+unsigned short  Field_Color[N_FIELD];
 
 // ------------------------------------------------------------------------------------------------------------
 
 unsigned const char V_Unit[4][3] = {"uV", "mV", "V ", "kV"};
 unsigned const char T_Unit[4][3] = {"ns", "us", "ms", "s "};
-unsigned const char F_Unit[4][4] = {"Hz ", "Hz ", "kHz", "MHz"};
+unsigned const char C_Unit[4][4] = {"mHz", "Hz ", "kHz", "MHz"};        // frequency, from mHz
+unsigned const char P_Unit[5][3] = {"ps", "ns", "us", "ms", "s "};      // counter period, from ps
+unsigned const char Gate_Unit[4][5] = {"Off", "0.1s", "1s", "10s"};
+unsigned const char Measure_Tag[N_MEASURE][4] = {"Frq", "Dty", "RMS", "Avg", "Vpp", "DCV", "Min", "Max",
+                                                  "Ton", "Ris", "Fal", "+Wd", "-Wd", "Per", "Ovs", "Pre", "THD", "T+N", "Wfm"};
+unsigned const char Stat_Unit[N_STAT_WINDOW][5] = {"All", "~4", "~16", "~64", "~256"};
+unsigned const char FFT_Unit[N_FFT_SIZE][5] = {"128", "512", "2048"};
+unsigned const char Window_Name[N_FFT_WINDOW][9] = {"Rect", "Hann", "Hamming", "B-Harris", "Flat Top"};
+unsigned const char Scale_Name[N_FFT_SCALE][9] = {"Linear", "5 dB/Div", "10dB/Div", "20dB/Div", "Top"};  // dBV shows its top
+unsigned const char Avg_Name[N_FFT_AVG][9] = {"Avg Off", "Exp 4", "Exp 16", "Lin 16", "Max Hold"};
+unsigned const char Zoom_Name[N_FFT_ZOOM][9] = {"Zoom Off", "Zoom x2", "Zoom x4", "Zoom x8", "Zoom x16"};
+unsigned const char Harm_Name[N_FFT_HARM][9] = {"Spectrum", "Harmonic", "Tones", "FFT Off"};
+unsigned const char Tone_Name[N_TONE_SET][9] = {"50Hz Hum", "60Hz Hum", "DTMF", "Center*N"};
+unsigned const char Stat_Tag[5][5] = {"Mean", "Dev ", "Min ", "Max ", "N   "};
 unsigned const char Battery_Status[5][4] = {"~`'", "~`}", "~|}", "{|}", "USB"};
 unsigned const short Battery_Color[5] = {RED, YEL, GRN, GRN, GRN};
 unsigned const char MODE_Unit[5][5] = {"AUTO", "NORM", "SING", "SCAN", "FIT"};
@@ -203,12 +285,60 @@ unsigned short Tp;
 unsigned char   FileNum[4] = "000";
 I32STR_RES      Num;
 
+int             Table_Val[N_MEASURE];   // value shown in each table cell
+unsigned int    Table_Mask;             // bit k set when cell k shows Table_Val[k]
+
+/*******************************************************************************
+ Function Name : Measure_Str
+ Description :  format value v of measure kind k into Num, returns its unit
+*******************************************************************************/
+static unsigned const char *Measure_Str(unsigned char k, int v)
+{
+   switch (k)
+   {
+   case 0: // frequency
+   case 18: // waveform update rate, records per 1000 s
+      Int32String(&Num, v, 3);
+      return C_Unit[Num.decPos];
+   case 1: // duty
+   case 14: // overshoot
+   case 15: // preshoot
+      Int32String(&Num, v, 3);
+      return "%";
+   case 16: // THD
+   case 17: // THD+N
+      if (v >= 1000) {
+         Int32String(&Num, v, 3);
+      } else {
+         Int32String(&Num, v + 1000, 4);  // 1.xxx, shown as 0.xxx
+         Num.str[0] = '0';
+      }
+      return "%";
+   case 2: // Vrms
+   case 4: // Vpp
+   case 8: // tone rms
+      Int32String(&Num, v, 3);
+      return V_Unit[Num.decPos];
+   case 3: // Vavg
+   case 5: // DCV
+   case 6: // Vmin
+   case 7: // Vmax
+      Int32String_sign(&Num, v, 3);
+      return V_Unit[Num.decPos];
+   default: // times
+      Int32String(&Num, v, 3);
+      return T_Unit[Num.decPos];
+   }
+}
+
 /*******************************************************************************
  Function Name : Update_Item
  Description :  update the items based on Update[x]
 *******************************************************************************/
 void     Update_Item(void)
 {
+   if ((Update_Mask[0] | Update_Mask[1]) == 0) return;
+
    if (Update[SYNC_MODE])
    {
       Update[SYNC_MODE] = 0;
@@ -232,83 +362,121 @@ void     Update_Item(void)
       Update[GND_POSITION] = 0;
       Set_Y_Pos(Item_Index[Y_SENSITIVITY], Item_Index[V0]);
    }
-   if (Update[MEASURE_KIND])//measure kind
+   if (Update[MEASURE_KIND] && (Measure_Counter == 0))//measure kind, at most every MEASURE_REFRESH ms
    {
-       unsigned char UpdateKind = 1;
-       Update[MEASURE_KIND] = 0;
-       switch (Item_Index[4])
-       {
-       case 0: // frequency
-          if (MeFr)
-          {
-             Int32String(&Num, Frequency, 3);
-             DisplayFieldEx(MeasureF, WHITE, 0, (unsigned const char *)Num.str, F_Unit[Num.decPos]);
-             UpdateKind = 0;
-          }
-          break;
-       case 1: // duty
-         if (MeFr)
-         {
-             Int32String(&Num, Duty, 3);
-             DisplayFieldEx(MeasureF, WHITE, 0, (unsigned const char *)Num.str, "%");
-             UpdateKind = 0;
-          }
-          break;
-       case 2: // Vrms
-          if (MeFr)
-          {
-             Int32String(&Num, Vrms, 3);
-             DisplayFieldEx(MeasureF, WHITE, 0, (unsigned const char *)Num.str, V_Unit[Num.decPos]);
-             UpdateKind = 0;
-          }
-          break;
-       case 3: // Vavg
-          if (MeFr)
-          {
-             Int32String_sign(&Num, Vavg, 3);
-             DisplayFieldEx(MeasureF, WHITE, 0, (unsigned const char *)Num.str, V_Unit[Num.decPos]);
-             UpdateKind = 0;
-          }
-          break;
-       case 4: // Vpp
-         if (MeDC) {
-             Int32String(&Num, Vpp, 3);
-             DisplayFieldEx(MeasureF, WHITE, 0, (unsigned const char *)Num.str,  V_Unit[Num.decPos]);
-             UpdateKind = 0;
-         }
-         break;
-
-       case 5: // DCV
-          if (MeDC) {
-             Int32String_sign(&Num, Vdc, 3);
-             DisplayFieldEx(MeasureF, WHITE, 0, (unsigned const char *)Num.str, V_Unit[Num.decPos]);
-             UpdateKind = 0;
-          }
-          break;
-       case 6: // Vmin
-          if (MeDC) {
-             Int32String_sign(&Num, Vmin, 3);
-             DisplayFieldEx(MeasureF, WHITE, 0, (unsigned const char *)Num.str, V_Unit[Num.decPos]);
-             UpdateKind = 0;
-          }
-          break;
-       case 7: // Vmax
-          if (MeDC) {
-             Int32String_sign(&Num, Vmax, 3);
-             DisplayFieldEx(MeasureF, WHITE, 0, (unsigned const char *)Num.str, V_Unit[Num.decPos]);
-             UpdateKind = 0;
-          }
-          break;
-       }
-      if (UpdateKind) DisplayField(MeasureF, WHITE, Sub[MeFreq + Item_Index[MEASURE_KIND]].Cmd);
-      if (Popup.Active && (Popup.Sub1 == MeFreq)) {
-        unsigned char Sub = Item_Index[MEASURE_KIND] + Popup.Sub1;
-        if (Popup.Sub != Sub) SelectSub(Sub);
+      int v;
+
+      Update[MEASURE_KIND] = 0;
+      Measure_Counter = MEASURE_REFRESH;
+      v = Measure_Value(Item_Index[MEASURE_KIND]);
+      if (v != NO_VALUE) {
+         unsigned const char *Unit = Measure_Str(Item_Index[MEASURE_KIND], v);
+         DisplayFieldEx(MeasureF, WHITE, 0, (unsigned const char *)Num.str, Unit);
+      } else
+         DisplayField(MeasureF, WHITE, Sub[MeFreq + Item_Index[MEASURE_KIND]].Cmd);
+      if (!Hide_Index[MEASURE_KIND]) {
+        if (Popup.Active == 0) ShowTable();
+        else if (Popup.Active == 2) RefreshTable();
+      } else if (Popup.Active == 2) {
+        HidePopup();
+        Update[CURSORS] = 1;
+      }
+      if ((Popup.Active == 1) && (Sub[Popup.Sub1].ci == MEASURE_KIND)) {
+        unsigned char Sub = Item_Index[MEASURE_KIND] + MeFreq;
+        if ((Popup.Sub != Sub) && (Sub >= Popup.Sub1) && (Sub <= Popup.Sub2)) SelectSub(Sub);
         else RefreshMeasure();
       }
       if (Item_Index[CI] == MEASURE_KIND)
         DisplayField(InfoF, WHITE, Sub[MeFreq + Item_Index[MEASURE_KIND]].Cmd);
    }
+   if (Update[MEASURE_STATS])
+   {
+      Update[MEASURE_STATS] = 0;
+      if (Item_Index[CI] == MEASURE_STATS)
+         DisplayFieldEx(InfoF, WHITE, "Stat", Stat_Unit[Item_Index[MEASURE_STATS]], "");
+   }
+   if (Update[MEASURE_GATE])
+   {
+      Update[MEASURE_GATE] = 0;
+      if (Item_Index[CI] == MEASURE_GATE)
+         DisplayFieldEx(InfoF, WHITE, "Gate", (unsigned const char *)(Item_Index[MEASURE_GATE] ? "T1-T2" : "Off"), "");
+   }
+   if (Update[FFT_SIZE])
+   {
+      Update[FFT_SIZE] = 0;
+      if (Item_Index[CI] == FFT_SIZE)
+         DisplayFieldEx(InfoF, WHITE, "FFT", FFT_Unit[Item_Index[FFT_SIZE]], "");
+   }
+   if (Update[FFT_WINDOW])
+   {
+      Update[FFT_WINDOW] = 0;
+      if (Item_Index[CI] == FFT_WINDOW)
+         DisplayField(InfoF, WHITE, Window_Name[Item_Index[FFT_WINDOW]]);
+   }
+   if (Update[FFT_SCALE])
+   {
+      Update[FFT_SCALE] = 0;
+      if ((Item_Index[CI] == FFT_SCALE) && (Item_Index[FFT_SCALE] == FFT_DBV)) {
+         // " +40dBV", a multiple of 10 below 1000
+         unsigned short t = (FFT_Top < 0) ? -FFT_Top : FFT_Top;
+         char *c = Num.str;
+         *c++ = ' ';
+         *c++ = (FFT_Top < 0) ? '-' : '+';
+         if (t >= 100) *c++ = '0' + t / 100;
+         if (t >= 10) *c++ = '0' + t / 10 % 10;
+         *c++ = '0';
+         *c = 0;
+         DisplayFieldEx(InfoF, WHITE, Scale_Name[FFT_DBV], (unsigned const char *)Num.str, "dBV");
+      } else if (Item_Index[CI] == FFT_SCALE)
+         DisplayField(InfoF, WHITE, Scale_Name[Item_Index[FFT_SCALE]]);
+   }
+   if (Update[FFT_AVG])
+   {
+      Update[FFT_AVG] = 0;
+      if (Item_Index[CI] == FFT_AVG)
+         DisplayField(InfoF, WHITE, Avg_Name[Item_Index[FFT_AVG]]);
+   }
+   if (Update[FFT_ZOOM])
+   {
+      Update[FFT_ZOOM] = 0;
+      if (Item_Index[CI] == FFT_ZOOM)
+         DisplayField(InfoF, WHITE, Zoom_Name[Item_Index[FFT_ZOOM]]);
+   }
+   if (Update[FFT_CENTER])
+   {
+      Update[FFT_CENTER] = 0;
+      if (Item_Index[CI] == FFT_CENTER)
+      {
+         // center in mHz, the sample rate is 72MHz / ((PSC + 1) * (ARR + 1))
+         unsigned long long k = (unsigned long long)FFT_CENTER_FS * (Scan_PSC[Item_Index[X_SENSITIVITY]] + 1) * (Scan_ARR[Item_Index[X_SENSITIVITY]] + 1);
+         Int32String(&Num, (Item_Index[FFT_CENTER] * 72000000000ULL + k / 2) / k, 4);
+         DisplayFieldEx(InfoF, WHITE, "", (unsigned const char *)Num.str, C_Unit[Num.decPos]);
+      }
+   }
+   if (Update[FFT_HARM])
+   {
+      Update[FFT_HARM] = 0;
+      if (Item_Index[CI] == FFT_HARM)
+         DisplayField(InfoF, WHITE, Harm_Name[Item_Index[FFT_HARM]]);
+   }
+   if (Update[TONE_SET])
+   {
+      Update[TONE_SET] = 0;
+      if (Item_Index[CI] == TONE_SET)
+         DisplayField(InfoF, WHITE, Tone_Name[Item_Index[TONE_SET]]);
+   }
+   if (Update[TONE_PICK])
+   {
+      Update[TONE_PICK] = 0;
+      if (Item_Index[CI] == TONE_PICK) {
+         Num.str[0] = '0' + Item_Index[TONE_PICK];
+         Num.str[1] = 0;
+         if (Item_Index[TONE_PICK])
+            DisplayFieldEx(InfoF, WHITE, "Vtone ", (unsigned const char *)Num.str, "");
+         else
+            DisplayField(InfoF, WHITE, "Strongest");
+      }
+   }
    if (Update[POWER_INFO])
    {
       Update[POWER_INFO] = 0;
@@ -408,6 +576,22 @@ void     Update_Item(void)
       if (Item_Index[CI] == OUTPUT_FREQUENCY)
          DisplayFieldEx(InfoF, WHITE, "Fr.", Item_F[Item_Index[OUTPUT_FREQUENCY]], "");
    }
+   if (Update[COUNTER_GATE])
+   {
+      Update[COUNTER_GATE] = 0;
+      if (Item_Index[CI] == COUNTER_GATE)
+      {
+         if (Counter_Freq == 0) // off, or no whole period in the last gate
+            DisplayFieldEx(InfoF, WHITE, "Gate ", Gate_Unit[Item_Index[COUNTER_GATE]], "");
+         else if (Menu[CurrentMenu].Sub == CntFreq) {
+            Int32String(&Num, Counter_Freq, 6);
+            DisplayFieldEx(InfoF, WHITE, 0, (unsigned const char *)Num.str, C_Unit[Num.decPos]);
+         } else {
+            Int32String(&Num, Counter_Period, 6);
+            DisplayFieldEx(InfoF, WHITE, 0, (unsigned const char *)Num.str, P_Unit[Num.decPos + Counter_TUnit]);
+         }
+      }
+   }
    if (Update[T2_CURSOR])
    {
       Update[T2_CURSOR] = 0;
@@ -543,22 +727,28 @@ void DrawMenu(void)
 
   for (i = 0; i < (sizeof(Menu) / sizeof(Menu[0])); i++)
   {
-    Display_Str(MAX_X + 3, MAX_Y - 17 - i * 20, YEL, PRN, Menu[i].Cmd);
+    Display_Str(MAX_X + 3, MAX_Y - 17 - i * MENU_PITCH, YEL, PRN, Menu[i].Cmd);
   }
 }
 
 void HidePopup(void)
 {
-   unsigned short i;
+   unsigned short i, x1, x2;
 
+   // repair only the area under the popup, cursors follow with Update[CURSORS]
    Popup.Active = 0;
-   Display_Grid(); // draw grid
-   for (i = 0; i < X_SIZE; i++)
+   if (!Hide_Index[MEASURE_KIND]) Update[MEASURE_KIND] = 1;  // table comes back
+   Display_Grid_Area(Popup.x, Popup.y, Popup.width, Popup.height);
+   x1 = Popup.x - MIN_X;
+   x2 = x1 + Popup.width;
+   if (x2 > X_SIZE) x2 = X_SIZE;
+   for (i = x1; i < x2; i++)
    {
-      Draw_SEG(i, Erase_Buffer[i], View_Buffer[i], WAV_COLOR);
+      Popup_SEG(i, Erase_Buffer[i], View_Buffer[i], WAV_COLOR);
    }
    if (!Hide_Index[REF])
-     Draw_Reference();
+     for (i = x1; i < x2; i++)
+       Popup_SEG(i, Ref_Buffer[i ? i - 1 : 0], Ref_Buffer[i], REF_COLOR);
 }
 
 void ShowPopup(void)
@@ -566,6 +756,8 @@ void ShowPopup(void)
    unsigned char i, t;
    short y;
 
+   if (Popup.Active) HidePopup();  // the menu popup takes the place of the table
+
    // find index of first sub option
    Popup.Sub = Popup.Sub1 = Popup.Sub2 = Menu[CurrentMenu].Sub;
    while ((Popup.Sub1 > 0) && (Sub[Popup.Sub1].Top != 1)) Popup.Sub1--;
@@ -579,15 +771,19 @@ void ShowPopup(void)
      t = strlen((char const *)Sub[i].Cmd);
      if (t > Popup.width) Popup.width = t;
    }
-   if (Popup.Sub1 == MeFreq) Popup.width += 9;  // space + 5 digits + 3 kind
-   Popup.width = Popup.width * 8 + 8;
+   Popup.lx = 0;
+   if (Sub[Popup.Sub1].ci == MEASURE_KIND) {
+     Popup.width += 9;  // space + 5 digits + 3 kind
+     Popup.lx = 8 * 13; // statistics panel, 12 characters and a space
+   }
+   Popup.width = Popup.width * 8 + 8 + Popup.lx;
 
    // determine height
    Popup.height = (Popup.Sub2 - Popup.Sub1 + 1) * 18 + 8;
 
    // determine x1, y1 pos for popup
    Popup.x = LCD_WIDTH - 24 - Popup.width;
-   Popup.y = MAX_Y - 17 + 7 - CurrentMenu * 20 - Popup.height / 2;
+   Popup.y = MAX_Y - 17 + 7 - CurrentMenu * MENU_PITCH - Popup.height / 2;
    if (Popup.y < 24) Popup.y = 24;
    while ((Popup.y + Popup.height) > (LCD_HEIGHT - 24)) Popup.y--;
    Popup.Sub = Menu[CurrentMenu].Sub;
@@ -597,76 +793,132 @@ void ShowPopup(void)
    y = Popup.y + Popup.height - 4 - 2 - 14;
    for (i = Popup.Sub1; i <= Popup.Sub2; i++) {
      unsigned char Typ = (Popup.Sub == i)?INV:PRN;
-     Display_Str(Popup.x + 4, y, WHITE, Typ, Sub[i].Cmd);
+     Display_Str(Popup.x + 4 + Popup.lx, y, WHITE, Typ, Sub[i].Cmd);
      if (Typ == INV) {
        t = strlen((char const *)Sub[i].Cmd);
-       Fill_Rectangle(Popup.x + 4 + t * 8, y, Popup.width - 8 - t * 8, 14, WHITE);
+       Fill_Rectangle(Popup.x + 4 + Popup.lx + t * 8, y, Popup.width - 8 - Popup.lx - t * 8, 14, WHITE);
      }
      y -= 18;
    }
    Popup.Active = 1;
-   if (Popup.Sub1 == MeFreq) RefreshMeasure();
+   if (Sub[Popup.Sub1].ci == MEASURE_KIND) RefreshMeasure();
 }
 
 void RefreshMeasure(void)
 {
    unsigned char i;
    short y, x1, x2;
+   int v;
 
    x1 = Popup.x + Popup.width - 4 - 1 - 8 * 8;
    x2 = x1 + 8 * 5;
    y = Popup.y + Popup.height - 4 - 2 - 14;
    for (i = Popup.Sub1; i <= Popup.Sub2; i++) {
      unsigned char Typ = (Popup.Sub == i)?INV:PRN;
-     if (MeFr || (MeDC && ((i - Popup.Sub1) >= 5))) {
-       switch (i - Popup.Sub1) {
-         case 0: // frequency
-            Int32String(&Num, Frequency, 3);
-            Display_Str(x1+8, y, WHITE, Typ, (unsigned const char *)Num.str);
-            Display_Str(x2, y, WHITE, Typ, F_Unit[Num.decPos]);
-            break;
-         case 1: // duty
-            Int32String(&Num, Duty, 3);
-            Display_Str(x1+8, y, WHITE, Typ, (unsigned const char *)Num.str);
-            Display_Str(x2, y, WHITE, Typ, "%");
-            break;
-         case 2: // Vrms
-            Int32String(&Num, Vrms, 3);
-            Display_Str(x1+8, y, WHITE, Typ, (unsigned const char *)Num.str);
-            Display_Str(x2, y, WHITE, Typ, V_Unit[Num.decPos]);
-            break;
-         case 3: // Vavg
-            Int32String_sign(&Num, Vavg, 3);
-            Display_Str(x1, y, WHITE, Typ, (unsigned const char *)Num.str);
-            Display_Str(x2, y, WHITE, Typ, V_Unit[Num.decPos]);
-            break;
-         case 4: // Vpp
-            Int32String(&Num, Vpp, 3);
-            Display_Str(x1+8, y, WHITE, Typ, (unsigned const char *)Num.str);
-            Display_Str(x2, y, WHITE, Typ, V_Unit[Num.decPos]);
-           break;
-         case 5: // DCV
-            Int32String_sign(&Num, Vdc, 3);
-            Display_Str(x1, y, WHITE, Typ, (unsigned const char *)Num.str);
-            Display_Str(x2, y, WHITE, Typ, V_Unit[Num.decPos]);
-            break;
-         case 6: // Vmin
-            Int32String_sign(&Num, Vmin, 3);
-            Display_Str(x1, y, WHITE, Typ, (unsigned const char *)Num.str);
-            Display_Str(x2, y, WHITE, Typ, V_Unit[Num.decPos]);
-            break;
-         case 7: // Vmax
-            Int32String_sign(&Num, Vmax, 3);
-            Display_Str(x1, y, WHITE, Typ, (unsigned const char *)Num.str);
-            Display_Str(x2, y, WHITE, Typ, V_Unit[Num.decPos]);
-            break;
-       }
+     v = Measure_Value(i - MeFreq);
+     if (v != NO_VALUE) {
+       unsigned const char *Unit = Measure_Str(i - MeFreq, v);
+       Display_Str(x2 - 8 * Num.len, y, WHITE, Typ, (unsigned const char *)Num.str);
+       Display_Str(x2, y, WHITE, Typ, Unit);
      } else {
        Fill_Rectangle(x1, y, Popup.width - (x1 - Popup.x) - 4, 14, (Typ == PRN)?FRM_COLOR:WHITE);
        Display_Str(x1 + 8 * 2, y, WHITE, Typ, "**");
      }
      y -= 18;
    }
+   RefreshStat(Popup.Sub - MeFreq);
+}
+
+/*******************************************************************************
+ Function Name : Stat_Line
+ Description :  one 12 character line of the statistics panel, the value
+                right aligned in 5 characters and the unit padded to 3
+*******************************************************************************/
+static void Stat_Line(short y, unsigned char i, unsigned const char *str, unsigned const char *Unit)
+{
+   unsigned char s[13], l = strlen((char const *)str), j;
+
+   memcpy(s, Stat_Tag[i], 4);
+   for (j = 4; j < 9; j++) s[j] = (j + l < 9) ? ' ' : *str++;
+   for (; j < 12; j++) s[j] = *Unit ? *Unit++ : ' ';
+   s[12] = 0;
+   Display_Str(Popup.x + 4, y, WHITE, PRN, s);
+}
+
+/*******************************************************************************
+ Function Name : RefreshStat
+ Description :  statistics panel of the measure popup, for measure kind k
+*******************************************************************************/
+void RefreshStat(unsigned char k)
+{
+   StatType *s = &Stat[k];
+   unsigned char c[6], i;
+   unsigned short n = s->Count;
+   short y = Popup.y + Popup.height - 4 - 2 - 14;
+
+   if (n == 0) {
+      for (i = 0; i < 4; i++, y -= 18) Stat_Line(y, i, "--", "");
+   } else {
+      unsigned const char *Unit;
+      Unit = Measure_Str(k, (int)((s->Mean + 32768) >> 16));
+      Stat_Line(y, 0, (unsigned const char *)Num.str, Unit);
+      y -= 18;
+      Unit = Measure_Str(k, (sqrt64(s->Var > 0 ? s->Var : 0) + 8) >> 4);
+      Stat_Line(y, 1, (unsigned const char *)Num.str, Unit);
+      y -= 18;
+      Unit = Measure_Str(k, s->Min);
+      Stat_Line(y, 2, (unsigned const char *)Num.str, Unit);
+      y -= 18;
+      Unit = Measure_Str(k, s->Max);
+      Stat_Line(y, 3, (unsigned const char *)Num.str, Unit);
+      y -= 18;
+   }
+   i = 5;
+   c[i] = 0;
+   do c[--i] = '0' + n % 10; while (n /= 10);
+   Stat_Line(y, 4, c + i, "");
+}
+
+/*******************************************************************************
+ Function Name : ShowTable
+ Description :  open the measure table in the popup area, the grid under it is
+                repaired by HidePopup like for the sub menu popup
+*******************************************************************************/
+void ShowTable(void)
+{
+   Popup.x = TABLE_X;
+   Popup.y = TABLE_Y;
+   Popup.width = TABLE_W;
+   Popup.height = TABLE_H;
+   Popup.lx = 0;
+   Rounded_Rectangle(Popup.x, Popup.y, Popup.width, Popup.height, FRM_COLOR);
+   memset(Field_Text[TableF], 0, N_MEASURE * sizeof(Field_Text[0]));  // cells are blank now
+   Table_Mask = 0;
+   Popup.Active = 2;
+   RefreshTable();
+}
+
+/*******************************************************************************
+ Function Name : RefreshTable
+ Description :  reformat only the cells whose value changed since last time,
+                DisplayFieldEx then skips the ones whose text did not change
+*******************************************************************************/
+void RefreshTable(void)
+{
+   unsigned char k;
+   int v;
+
+   for (k = 0; k < N_MEASURE; k++) {
+     v = Measure_Value(k);
+     if ((Table_Mask & (1 << k)) && (Table_Val[k] == v)) continue;
+     Table_Val[k] = v;
+     Table_Mask |= 1 << k;
+     if (v != NO_VALUE) {
+       unsigned const char *Unit = Measure_Str(k, v);
+       DisplayFieldEx(TableF + k, WHITE, Measure_Tag[k], (unsigned const char *)Num.str, Unit);
+     } else
+       DisplayFieldEx(TableF + k, WHITE, Measure_Tag[k], "  --", "");
+   }
 }
 
 void SelectSub(unsigned char pi)
@@ -678,18 +930,18 @@ void SelectSub(unsigned char pi)
    else if (pi > Popup.Sub2) pi = Popup.Sub1;
    // remove selection
    y = Popup.y + Popup.height - 4 - 2 - 14 - 18 * (Popup.Sub - Popup.Sub1);
-   Display_Str(Popup.x + 4, y, WHITE, PRN, Sub[Popup.Sub].Cmd);
+   Display_Str(Popup.x + 4 + Popup.lx, y, WHITE, PRN, Sub[Popup.Sub].Cmd);
    t = strlen((char const *)Sub[Popup.Sub].Cmd);
-   Fill_Rectangle(Popup.x + 4 + t * 8, y, Popup.width - 8 - t * 8, 14, FRM_COLOR);
+   Fill_Rectangle(Popup.x + 4 + Popup.lx + t * 8, y, Popup.width - 8 - Popup.lx - t * 8, 14, FRM_COLOR);
 
    // add selection
    Popup.Sub = pi;
    y = Popup.y + Popup.height - 4 - 2 - 14 - 18 * (Popup.Sub - Popup.Sub1);
-   Display_Str(Popup.x + 4, y, WHITE, INV, Sub[Popup.Sub].Cmd);
+   Display_Str(Popup.x + 4 + Popup.lx, y, WHITE, INV, Sub[Popup.Sub].Cmd);
    t = strlen((char const *)Sub[Popup.Sub].Cmd);
-   Fill_Rectangle(Popup.x + 4 + t * 8, y, Popup.width - 8 - t * 8, 14, WHITE);
+   Fill_Rectangle(Popup.x + 4 + Popup.lx + t * 8, y, Popup.width - 8 - Popup.lx - t * 8, 14, WHITE);
 
-   if (Popup.Sub1 == MeFreq) Item_Index[MEASURE_KIND] = Popup.Sub - Popup.Sub1;
+   if (Sub[Popup.Sub].ci == MEASURE_KIND) Item_Index[MEASURE_KIND] = Popup.Sub - MeFreq;
    Menu[CurrentMenu].Sub = Popup.Sub;
    DisplayField(InfoF, WHITE, Sub[Menu[CurrentMenu].Sub].Cmd);
 
@@ -700,8 +952,8 @@ void SelectMenu(unsigned char mi)
 {
     if (mi == 255) mi = N_MENU - 1;
     else if (mi >= N_MENU) mi = 0;
-    Display_Str(MAX_X + 3, MAX_Y - 17 - CurrentMenu * 20, YEL, PRN, Menu[CurrentMenu].Cmd);
-    Display_Str(MAX_X + 3, MAX_Y - 17 - mi * 20, WHITE, INV, Menu[mi].Cmd);
+    Display_Str(MAX_X + 3, MAX_Y - 17 - CurrentMenu * MENU_PITCH, YEL, PRN, Menu[CurrentMenu].Cmd);
+    Display_Str(MAX_X + 3, MAX_Y - 17 - mi * MENU_PITCH, WHITE, INV, Menu[mi].Cmd);
     CurrentMenu = mi;
 
     DisplayField(InfoF, WHITE, Sub[Menu[CurrentMenu].Sub].Cmd);
@@ -711,18 +963,36 @@ void SelectMenu(unsigned char mi)
 void DisplayFieldEx(unsigned char fi, unsigned short Color, unsigned const char *pre, unsigned const char *str, unsigned const char *suf)
 {
     unsigned short w1 = 0, w2 = 0, w3 = 0, x;
+    unsigned char  l1 = 0, l2, l3, *p = Field_Text[fi];
+
+    // skip the repaint when the field already shows exactly this text
+    if (pre) l1 = strlen((char const *)pre) + 1;
+    l2 = strlen((char const *)str);
+    l3 = strlen((char const *)suf);
+    if (l1 + l2 + 1 + l3 < sizeof(Field_Text[0])) {
+      if ((Field_Color[fi] == Color) && (p[l1 + l2] == 2) && (p[l1 + l2 + 1 + l3] == 0)
+          && ((l1 == 0) || ((p[l1 - 1] == 1) && (memcmp(p, pre, l1 - 1) == 0)))
+          && (memcmp(p + l1, str, l2) == 0) && (memcmp(p + l1 + l2 + 1, suf, l3) == 0))
+        return;
+      if (l1) { memcpy(p, pre, l1 - 1); p[l1 - 1] = 1; }
+      memcpy(p + l1, str, l2);
+      p[l1 + l2] = 2;
+      memcpy(p + l1 + l2 + 1, suf, l3);
+      p[l1 + l2 + 1 + l3] = 0;
+      Field_Color[fi] = Color;
+    } else p[0] = 0;  // too long to cache, always repaint
 
     if (pre) {
-      w1 = strlen((char const *)pre) * 8;
+      w1 = (l1 - 1) * 8;
       Display_Str(Field[fi].x, Field[fi].y, Color, PRN, pre);
       Fill_Rectangle(Field[fi].x + w1, Field[fi].y, 4, 14, FRM_COLOR);
       w1 += 4;
     }
 
-    w2 = strlen((char const *)str) * 8;
+    w2 = l2 * 8;
     Display_Str(Field[fi].x + w1, Field[fi].y, Color, PRN, str);
 
-    w3 = strlen((char const *)suf) * 8;
+    w3 = l3 * 8;
     Display_Str(Field[fi].x + w1 + w2, Field[fi].y, Color, PRN, suf);
 
     x = Field[fi].width - w1 - w2 - w3;
@@ -763,6 +1033,42 @@ void LoadWave(void)
      DisplayField(InfoF, WHITE, SD_Msgs[NoCard]);
 }
 
+/*******************************************************************************
+ Function Name : SaveStat
+ Description :  write the measure statistics as the second sector of the opened
+                file, little endian: "ST", window, N_MEASURE, then for each
+                kind in menu order count, mean, deviation, min, max (32 bit)
+*******************************************************************************/
+static void Put_Int(unsigned char *p, unsigned int v)
+{
+   p[0] = v;
+   p[1] = v >> 8;
+   p[2] = v >> 16;
+   p[3] = v >> 24;
+}
+
+static char SaveStat(void)
+{
+   StatType *s = Stat;
+   unsigned char *p = F_Buff + 6, k;
+
+   if (Next_Sector()) return 0xff;
+   memset(F_Buff, 0, sizeof(F_Buff));
+   F_Buff[0] = 'S';
+   F_Buff[1] = 'T';
+   F_Buff[2] = Stat_Window[Item_Index[MEASURE_STATS]];
+   F_Buff[3] = Stat_Window[Item_Index[MEASURE_STATS]] >> 8;
+   F_Buff[4] = N_MEASURE;
+   for (k = 0; k < N_MEASURE; k++, s++, p += 20) {
+     Put_Int(p, s->Count);
+     Put_Int(p + 4, (s->Mean + 32768) >> 16);
+     Put_Int(p + 8, (sqrt64(s->Var > 0 ? s->Var : 0) + 8) >> 4);
+     Put_Int(p + 12, s->Min);
+     Put_Int(p + 16, s->Max);
+   }
+   return Write_File();
+}
+
 void SaveWave(void)
 {
   Update[SAVE_WAVE_CURVE] = 0;
@@ -773,10 +1079,12 @@ void SaveWave(void)
          Char_to_Str(FileNum, Item_Index[SAVE_WAVE_CURVE]);
          if (Open_File("FILE",FileNum,"DAT") == 0)
          {
+            unsigned char st = (File_Size >= 1024);  // room for the statistics sector
+
             F_Buff[0] = 0;
-            F_Buff[1] = 0;
+            F_Buff[1] = st;
             memcpy(F_Buff + 2, View_Buffer, 300);
-            if (Write_File() == 0)
+            if ((Write_File() == 0) && (!st || (SaveStat() == 0)))
             {
                if (Item_Index[SAVE_WAVE_CURVE] < 255)
                   Item_Index[SAVE_WAVE_CURVE]++;
@@ -889,16 +1197,20 @@ unsigned char CheckSub(unsigned char SubOrg, unsigned char SubNew)
    return SubOrg;
 }
 
+// profile layout in F_Buff: 0x30, N_ITEM, Item_Index, Hide_Index, Menu[].Sub
+#define CFG_HIDE  (2 + sizeof(Item_Index))
+#define CFG_MENU  (CFG_HIDE + sizeof(Hide_Index))
+
 void PutConfig(void)
 {
   unsigned short i;
 
   F_Buff[0] = 0x30;
-  F_Buff[1] = 0x00;
+  F_Buff[1] = N_ITEM;
   memcpy(F_Buff + 2, Item_Index, sizeof(Item_Index));
-  memcpy(F_Buff + 64, Hide_Index, sizeof(Hide_Index));
-  for (i = 0; i < 9; i ++)
-    F_Buff[2 + 96 + i] = Menu[i].Sub;
+  memcpy(F_Buff + CFG_HIDE, Hide_Index, sizeof(Hide_Index));
+  for (i = 0; i < N_MENU; i ++)
+    F_Buff[CFG_MENU + i] = Menu[i].Sub;
 }
 
 void RestoreConfig(void)
@@ -906,12 +1218,12 @@ void RestoreConfig(void)
    unsigned char t = Menu[CurrentMenu].Sub;    // preserve active menu option
    unsigned short i;
 
-   if ((F_Buff[0] == 0x30) && (F_Buff[1] == 0x00)) {
+   if ((F_Buff[0] == 0x30) && (F_Buff[1] == N_ITEM)) {
       Erase_Sensitivity();
       memcpy(Item_Index, F_Buff + 2, sizeof(Item_Index));
-      memcpy(Hide_Index, F_Buff + 64, sizeof(Hide_Index));
-      for (i = 0; i < 9; i ++)
-        Menu[i].Sub = CheckSub(Menu[i].Sub,F_Buff[2 + 96 + i]);
+      memcpy(Hide_Index, F_Buff + CFG_HIDE, sizeof(Hide_Index));
+      for (i = 0; i < N_MENU; i ++)
+        Menu[i].Sub = CheckSub(Menu[i].Sub,F_Buff[CFG_MENU + i]);
       Menu[CurrentMenu].Sub = t;  // restore active menu
    }
    ApplyConfig();
@@ -922,10 +1234,25 @@ void ApplyConfig(void)
    memset(Signal_Buffer, 0xff, sizeof(Signal_Buffer));
    memset(View_Buffer, 0xff, sizeof(View_Buffer));
    memset(Erase_Buffer, 0xff, sizeof(Erase_Buffer));
-   memset((void *)Update, 1, sizeof(Update));
+   Update_Mask[0] = 0xFFFFFFFF;
+   Update_Mask[1] = 0xFFFFFFFF >> (64 - N_ITEM);
    Item_Index[RUNNING_STATUS] = RUN;
    Item_Index[POWER_INFO] = 3;
    if (Item_Index[TP] > BUFFER_SIZE) Item_Index[TP] = BUFFER_SIZE;
+   if (Item_Index[COUNTER_GATE] > 3) Item_Index[COUNTER_GATE] = 0;  // profile saved before the counter
+   Counter_Start(Item_Index[COUNTER_GATE]);
+   if (Item_Index[MEASURE_STATS] >= N_STAT_WINDOW) Item_Index[MEASURE_STATS] = 0;
+   Item_Index[MEASURE_GATE] &= 1;
+   if (Item_Index[FFT_SIZE] >= N_FFT_SIZE) Item_Index[FFT_SIZE] = 1;
+   if (Item_Index[FFT_WINDOW] >= N_FFT_WINDOW) Item_Index[FFT_WINDOW] = 1;
+   if (Item_Index[FFT_SCALE] >= N_FFT_SCALE) Item_Index[FFT_SCALE] = 0;
+   if (Item_Index[FFT_AVG] >= N_FFT_AVG) Item_Index[FFT_AVG] = 0;
+   if (Item_Index[FFT_ZOOM] >= N_FFT_ZOOM) Item_Index[FFT_ZOOM] = 0;
+   if (Item_Index[FFT_HARM] >= N_FFT_HARM) Item_Index[FFT_HARM] = 0;
+   if (Item_Index[TONE_SET] >= N_TONE_SET) Item_Index[TONE_SET] = 0;
+   if (Item_Index[TONE_PICK] >= N_TONE_PICK) Item_Index[TONE_PICK] = 0;
+   FFT_Move_Center(0);   // also restarts the average
+   Stat_Reset();
    Popup.Active = 0;
    Item_Index[CI] = Sub[Menu[CurrentMenu].Sub].ci;
    Display_Grid();
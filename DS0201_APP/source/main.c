@@ -12,9 +12,6 @@ File Name: main.c
 #include "string.h"
 #include "ASM_Function.h"
 
-/* For libc functions used by the ST DSP library (FFT) */
-int __errno = 0;
-
 void   main(void)
 {
    unsigned short i;
@@ -24,6 +21,7 @@ void   main(void)
    if (pLib->Signature != LIB_SIGNATURE)  // incompatible library
      while (1); // halt, we can not display an error as we have no font table
 
+   Init_Font();
    NVIC_SetVectorTable(NVIC_VectTab_FLASH, 0xC000);
    NVIC_Configuration();
 
@@ -50,23 +48,26 @@ void   main(void)
    while (1) {
      Update_Item();
      Scan_Wave();
+     FFT_Step();
+     Counter_Poll();
 
      if (Key_Buffer) {
+       FFT_Finish();  // keys change the FFT settings and the file operations take its scratch
 
        if (Key_Buffer == KEYCODE_UP) {
-         if (Popup.Active)
+         if (Popup.Active == 1)
           SelectSub(Popup.Sub - 1);
          else
           SelectMenu(CurrentMenu - 1);
        }
        if (Key_Buffer == KEYCODE_DOWN) {
-         if (Popup.Active)
+         if (Popup.Active == 1)
            SelectSub(Popup.Sub + 1);
          else
            SelectMenu(CurrentMenu + 1);
        }
        if (Key_Buffer == KEYCODE_M) {
-         if (Popup.Active)
+         if (Popup.Active == 1)
            HidePopup();
          else
            ShowPopup();
@@ -84,9 +85,10 @@ void   main(void)
 
        Update[Item_Index[CI]] = 1;
        Update[CURSORS] = 1;
+       Measure_Counter = 0;  // show key changes without waiting for the refresh interval
 
        if (Key_Buffer == KEYCODE_B) {
-         if (Popup.Active) {
+         if (Popup.Active == 1) {
            HidePopup();
            Update_Item();
            Update[Item_Index[CI]] = 1;
@@ -186,12 +188,28 @@ void   main(void)
             Item_Index[CALIBRATE_RANGE] = 100;
             break;
 
+         case MEASURE_KIND:
+            Hide_Index[MEASURE_KIND] = (Hide_Index[MEASURE_KIND] + 1) & 1;  // show or hide measure table
+            break;
+
+         case MEASURE_STATS:
+            Stat_Reset();
+            break;
+
+         case MEASURE_GATE:
+            Item_Index[MEASURE_GATE] = (Item_Index[MEASURE_GATE] + 1) & 1;  // gate measurements on T1..T2
+            Stat_Reset();
+            break;
+
+         case FFT_AVG:
+            FFT_Avg_Reset();  // restart the average or the max hold
+            break;
+
 //         case Y_SENSITIVITY:
 //         case X_SENSITIVITY:
 //         case TRIG_SLOPE:
 //         case OUTPUT_FREQUENCY:
 //         case GND_POSITION:
-//         case MEASURE_KIND:
 //         case INPUT_ATTENUATOR:
 
        }/*switch*/
@@ -297,6 +315,94 @@ void   main(void)
                Item_Index[OUTPUT_FREQUENCY]--;
             break;
 
+         case COUNTER_GATE:
+            if ((Key_Buffer == KEYCODE_RIGHT) && (Item_Index[COUNTER_GATE] < 3))
+               Item_Index[COUNTER_GATE]++;
+            if ((Key_Buffer == KEYCODE_LEFT) && (Item_Index[COUNTER_GATE] > 0))
+               Item_Index[COUNTER_GATE]--;
+            Counter_Start(Item_Index[COUNTER_GATE]);
+            break;
+
+         case MEASURE_STATS:
+            if ((Key_Buffer == KEYCODE_RIGHT) && (Item_Index[MEASURE_STATS] < N_STAT_WINDOW - 1))
+               Item_Index[MEASURE_STATS]++;
+            if ((Key_Buffer == KEYCODE_LEFT) && (Item_Index[MEASURE_STATS] > 0))
+               Item_Index[MEASURE_STATS]--;
+            Stat_Reset();
+            break;
+
+         case MEASURE_GATE:
+            Item_Index[MEASURE_GATE] = (Key_Buffer == KEYCODE_RIGHT);
+            Stat_Reset();
+            break;
+
+         case FFT_SIZE:
+            if ((Key_Buffer == KEYCODE_RIGHT) && (Item_Index[FFT_SIZE] < N_FFT_SIZE - 1))
+               Item_Index[FFT_SIZE]++;
+            if ((Key_Buffer == KEYCODE_LEFT) && (Item_Index[FFT_SIZE] > 0))
+               Item_Index[FFT_SIZE]--;
+            break;
+
+         case FFT_WINDOW:
+            if ((Key_Buffer == KEYCODE_RIGHT) && (Item_Index[FFT_WINDOW] < N_FFT_WINDOW - 1))
+               Item_Index[FFT_WINDOW]++;
+            if ((Key_Buffer == KEYCODE_LEFT) && (Item_Index[FFT_WINDOW] > 0))
+               Item_Index[FFT_WINDOW]--;
+            break;
+
+         case FFT_SCALE:
+            if ((Key_Buffer == KEYCODE_RIGHT) && (Item_Index[FFT_SCALE] < N_FFT_SCALE - 1))
+               Item_Index[FFT_SCALE]++;
+            if ((Key_Buffer == KEYCODE_LEFT) && (Item_Index[FFT_SCALE] > 0))
+               Item_Index[FFT_SCALE]--;
+            break;
+
+         case FFT_AVG:
+            if ((Key_Buffer == KEYCODE_RIGHT) && (Item_Index[FFT_AVG] < N_FFT_AVG - 1))
+               Item_Index[FFT_AVG]++;
+            if ((Key_Buffer == KEYCODE_LEFT) && (Item_Index[FFT_AVG] > 0))
+               Item_Index[FFT_AVG]--;
+            break;
+
+         case FFT_ZOOM:
+            if ((Key_Buffer == KEYCODE_RIGHT) && (Item_Index[FFT_ZOOM] < N_FFT_ZOOM - 1))
+               Item_Index[FFT_ZOOM]++;
+            if ((Key_Buffer == KEYCODE_LEFT) && (Item_Index[FFT_ZOOM] > 0))
+               Item_Index[FFT_ZOOM]--;
+            FFT_Move_Center(0);   // the wider view may cross 0 or half the sample rate
+            break;
+
+         case FFT_CENTER:
+            FFT_Move_Center((Key_Buffer == KEYCODE_RIGHT) ? 1 : -1);   // one column of the view
+            break;
+
+         case FFT_HARM:
+            if ((Key_Buffer == KEYCODE_RIGHT) && (Item_Index[FFT_HARM] < N_FFT_HARM - 1))
+               Item_Index[FFT_HARM]++;
+            if ((Key_Buffer == KEYCODE_LEFT) && (Item_Index[FFT_HARM] > 0))
+               Item_Index[FFT_HARM]--;
+            if (Item_Index[FFT_HARM] == FFT_VIEW_OFF) {
+               Erase_FFT();
+               Thd = ThdN = Vtone = NO_MEASURE;
+               Update[TRIG_LEVEL] = 1;   // the peak readout gives the field back
+            }
+            break;
+
+         case TONE_SET:
+            if ((Key_Buffer == KEYCODE_RIGHT) && (Item_Index[TONE_SET] < N_TONE_SET - 1))
+               Item_Index[TONE_SET]++;
+            if ((Key_Buffer == KEYCODE_LEFT) && (Item_Index[TONE_SET] > 0))
+               Item_Index[TONE_SET]--;
+            break;
+
+         case TONE_PICK:
+            if ((Key_Buffer == KEYCODE_RIGHT) && (Item_Index[TONE_PICK] < N_TONE_PICK - 1))
+               Item_Index[TONE_PICK]++;
+            if ((Key_Buffer == KEYCODE_LEFT) && (Item_Index[TONE_PICK] > 0))
+               Item_Index[TONE_PICK]--;
+            Stat_Reset();   // Vtone follows another tone
+            break;
+
          case T2_CURSOR:
             Draw_Ti_Mark(Item_Index[T2], ERASE, LN2_COLOR);
             Draw_Ti_Line(Item_Index[T2], ERASE, LN2_COLOR);
@@ -368,7 +474,7 @@ void   main(void)
          case MEASURE_KIND:
             if (Key_Buffer == KEYCODE_RIGHT)
             {
-               if (Item_Index[MEASURE_KIND] < 7)
+               if (Item_Index[MEASURE_KIND] < N_MEASURE - 1)
                   Item_Index[MEASURE_KIND]++; // next measure kind
                else
                   Item_Index[MEASURE_KIND] = 0;
@@ -378,7 +484,7 @@ void   main(void)
                if (Item_Index[MEASURE_KIND] > 0)
                   Item_Index[MEASURE_KIND]--; // previous measure kind
                else
-                  Item_Index[MEASURE_KIND] = 7;
+                  Item_Index[MEASURE_KIND] = N_MEASURE - 1;
             }
             break;
 
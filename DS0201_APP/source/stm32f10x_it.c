@@ -182,8 +182,19 @@ void            TIM1_CC_IRQHandler(void)
 {
 }
 
+/****************************************************************************
+Function Name : TIM2_IRQHandler
+Description : TIMER 2 interrupt request handle, overflows and CH1 input
+              captures of the frequency counter
+******************************************************************************/
 void            TIM2_IRQHandler(void)
 {
+   unsigned int sr = TIM2_SR, ccr = 0;
+
+   if (sr & 0x0002)
+      ccr = TIM2_CCR1; // reading CCR1 clears CC1IF
+   TIM2_SR = ~(sr & 0x0201); // clear UIF and CC1OF as seen, rc_w0
+   Counter_Capture(sr, ccr);
 }
 /****************************************************************************
 Function Name : TIM3_IRQHandler
@@ -205,6 +216,14 @@ void            TIM3_IRQHandler(void)
    if (Refresh_Counter)
       Refresh_Counter--;
 
+   if (Measure_Counter)
+      Measure_Counter--;
+
+   Counter_Tick();
+
+   if (Rate_Time < 0xffff)
+      Rate_Time++;
+
    if (Counter_20ms)
       Counter_20ms--;
 
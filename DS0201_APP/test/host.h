@@ -0,0 +1,27 @@
+/*******************************************************************************
+ File name  : host.h
+ Description : host build of Function.c for the checks, a test includes this
+               and then ../source/Function.c itself to reach its static parts
+ *******************************************************************************/
+#ifndef __host_H__
+#define __host_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "stm32f10x_lib.h"
+#include "Function.h"
+#include "Menu.h"
+
+// the bit-band alias has no meaning here, the flags get a plain array
+#undef Update
+#define Update Host_Update
+extern volatile u32 Host_Update[64];
+
+extern char Host_Text[8][32];   // last text of the first status fields
+extern int  Host_Bar[320];      // top of the segment drawn in each column, 0 if erased
+extern int  Host_Fonts;         // Init_Font calls
+
+#endif
+/********************************* END OF FILE ********************************/
@@ -0,0 +1,86 @@
+/*******************************************************************************
+ File name  : stubs.c
+ Description : what Function.c takes from the rest of the firmware, the
+               scale tables as in Menu.c and a double precision model of the
+               ST radix-4 FFT: DFT / N, 16 bit real low, imaginary high
+ *******************************************************************************/
+#include "host.h"
+#include "Lcd.h"
+#include "Calculate.h"
+
+volatile u32 Host_Update[64];
+char Host_Text[8][32];
+int  Host_Bar[320];
+int  Host_Fonts;
+
+unsigned short Item_Index[N_ITEM];
+volatile unsigned int Update_Mask[2];
+unsigned short Tp;
+volatile unsigned short Refresh_Counter;
+unsigned const char C_Unit[4][4] = {"mHz", "Hz ", "kHz", "MHz"};
+
+unsigned const int V_Scale[20] =
+ {400, 800, 2000, 4000, 8000, 20000, 40000, 80000, 200000, 400000,
+  8000, 20000, 40000, 80000, 200000, 400000, 800000, 2000000, 4000000, 0};
+unsigned short Km[20] =
+ {2956, 1478, 591,  296, 1114, 446,  223, 1157, 463, 231,
+  1452,  581, 290, 1082,  433, 216, 1048,  419, 210, 231};
+unsigned const short Scan_PSC[22] =
+ {11, 11, 11, 11, 11, 15, 15, 15, 15, 15, 15, 31, 63, 63, 127, 255, 255, 255, 511, 511, 511, 1023 };
+unsigned const short Scan_ARR[22] =
+ {6, 6, 6, 6, 6, 8, 17, 35, 89, 179, 359, 449, 449, 899, 1124, 1124, 2249, 5624, 5624, 11249, 28124, 28124 };
+
+void ADC_Start(void) {}
+void ADC_Stop(void) {}
+void NVIC_SETPRIMASK(void) {}
+void NVIC_RESETPRIMASK(void) {}
+void Erase_Sensitivity(void) {}
+void Erase_Trig_Pos(void) {}
+void Draw_Ti_Line(unsigned short Ti, char Mode, unsigned short Color) {}
+void Draw_Ti_Mark(unsigned short Ti, char Mode, unsigned short Color) {}
+void Init_Font(void) { Host_Fonts++; }
+
+void Draw_SEG(unsigned short x, unsigned short y1, unsigned short y2, unsigned short Color)
+{
+  if (x < 320) Host_Bar[x] = y2;
+}
+
+void Erase_SEG(unsigned short x, unsigned short y1, unsigned short y2, unsigned short Color)
+{
+  if (x < 320) Host_Bar[x] = 0;
+}
+
+void DisplayFieldEx(unsigned char fi, unsigned short Color, unsigned const char *pre, unsigned const char *str, unsigned const char *suf)
+{
+  if (fi < 8) snprintf(Host_Text[fi], 32, "%s%s%s", pre, str, suf);
+}
+
+static void Host_FFT(void *out, void *in, unsigned short n)
+{
+  static double re[1024], im[1024];
+  int *o = out, *x = in, i, j, k, m, len;
+
+  for (i = 0; i < n; i++) {
+    for (j = 0, k = i, m = 1; m < n; m <<= 1, k >>= 1) j = (j << 1) | (k & 1);
+    re[j] = (short)(x[i] & 0xffff);
+    im[j] = (short)(x[i] >> 16);
+  }
+  for (len = 2; len <= n; len <<= 1)
+    for (i = 0; i < n; i += len)
+      for (k = 0; k < len / 2; k++) {
+        double a = -2 * M_PI * k / len, c = cos(a), s = sin(a);
+        double tr = re[i + k + len / 2] * c - im[i + k + len / 2] * s;
+        double ti = re[i + k + len / 2] * s + im[i + k + len / 2] * c;
+        re[i + k + len / 2] = re[i + k] - tr;
+        im[i + k + len / 2] = im[i + k] - ti;
+        re[i + k] += tr;
+        im[i + k] += ti;
+      }
+  for (k = 0; k < n; k++)
+    o[k] = ((int)lround(im[k] / n) << 16) | ((int)lround(re[k] / n) & 0xffff);
+}
+
+void cr4_fft_64_stm32(void *pssOUT, void *pssIN, u16 Nbin) { Host_FFT(pssOUT, pssIN, 64); }
+void cr4_fft_256_stm32(void *pssOUT, void *pssIN, u16 Nbin) { Host_FFT(pssOUT, pssIN, 256); }
+void cr4_fft_1024_stm32(void *pssOUT, void *pssIN, u16 Nbin) { Host_FFT(pssOUT, pssIN, 1024); }
+/********************************* END OF FILE ********************************/
@@ -0,0 +1,152 @@
+/*******************************************************************************
+ File name  : t_avg.c
+ Description : host check of the spectrum average of Draw_FFT: the equal
+               weight warm-up over the first N frames, the exponential
+               average or the hold after it and the max hold against double
+               references through a level step, and the restart when a
+               setting in the average key changes but not when another does
+ *******************************************************************************/
+#include "host.h"
+#include "../source/Function.c"
+
+#define POINTS 512                      // FFT_SIZE 1, two bins per column
+#define FRAMES 60
+#define STEP   30                       // the frame of the level step
+
+static unsigned int H[FFT_COLS];        // the column magnitudes of the frame
+static const char *const Avg_Name[N_FFT_AVG] = {"off", "Exp 4", "Exp 16", "Lin 16", "Max Hold"};
+
+// frame k: columns of their own level with noise, up or down at STEP, one
+// column above the 12 bit full scale
+static void Frame(int k)
+{
+  int c, b;
+
+  for (c = 0; c < FFT_COLS; c++) {
+    H[c] = 200 + (c * 37) % 3000 + rand() % 400;
+    if (k >= STEP) H[c] = (c & 1) ? H[c] / 3 : H[c] + 800;
+    if (c == 5) H[c] = 5000;
+    for (b = c * POINTS / (2 * FFT_COLS); b < (c + 1) * POINTS / (2 * FFT_COLS); b++) FFT_mag[b] = H[c];
+  }
+  Draw_FFT(POINTS, 0);
+}
+
+// the average each mode should hold after frame k of the column levels h,
+// in 1/16 like FFT_Avg
+static void Ref_Average(unsigned char a, int k, double *ref, double *sum)
+{
+  int c;
+  double h, n = FFT_Avg_N[a];
+
+  for (c = 0; c < FFT_COLS; c++) {
+    h = (H[c] > 0xfff) ? 0xfff : H[c];
+    sum[c] += h;
+    if (a == AVG_MAX)
+      ref[c] = ((k == 1) || (16 * h > ref[c])) ? 16 * h : ref[c];
+    else if (k <= n)
+      ref[c] = 16 * sum[c] / k;          // 1/1, 1/2 .. 1/N: the plain mean
+    else if (a != AVG_LIN)
+      ref[c] += (16 * h - ref[c]) / n;   // then exponential with 1/N
+  }
+}
+
+// the settings Draw_FFT keys the average with, and a few it does not
+typedef struct {
+  const char    *Name;
+  unsigned char Item, Value, Key;
+} ChangeType;
+
+static const ChangeType Changes[] = {
+  {"timebase",      X_SENSITIVITY,  11, 1},
+  {"V/Div",         Y_SENSITIVITY,  4,  1},
+  {"FFT size",      FFT_SIZE,       2,  1},
+  {"window",        FFT_WINDOW,     3,  1},
+  {"average",       FFT_AVG,        1,  1},
+  {"zoom",          FFT_ZOOM,       2,  1},
+  {"view",          FFT_HARM,       FFT_VIEW_TONE, 1},
+  {"tone set",      TONE_SET,       1,  1},
+  {"scale",         FFT_SCALE,      2,  0},
+  {"zoom center",   FFT_CENTER,     90, 0},
+  {"V0",            V0,             60, 0},
+};
+#define N_CHANGES (sizeof(Changes) / sizeof(Changes[0]))
+
+int main(int argc, char **argv)
+{
+  unsigned char a;
+  unsigned int i, c, k, frames, fails = 0;
+  double ref[FFT_COLS], sum[FFT_COLS], e, worst, bound;
+  unsigned short v;
+
+  Item_Index[X_SENSITIVITY] = 10;
+  Item_Index[Y_SENSITIVITY] = 3;
+  Item_Index[FFT_SIZE] = 1;
+  Item_Index[FFT_CENTER] = 700;
+
+  // each mode through the warm-up, after it and across the level step, to
+  // the truncation of d / n: each frame adds below one 1/16 and the
+  // weight 1/n takes away 1/n of what is there, N of 1/16 at most
+  for (a = 1; a < N_FFT_AVG; a++) {
+    Item_Index[FFT_AVG] = a;
+    FFT_Avg_Reset();
+    memset(sum, 0, sizeof(sum));
+    bound = (a == AVG_MAX) ? 0 : FFT_Avg_N[a];
+    srand(a);
+    for (worst = 0, k = 1; k <= FRAMES; k++) {
+      Frame(k);
+      Ref_Average(a, k, ref, sum);
+      for (c = 0; c < FFT_COLS; c++) {
+        e = fabs(FFT_Avg[c] - ref[c]);
+        if (e > worst) worst = e;
+        if (e > bound) {
+          if (fails++ < 10)
+            printf("t_avg: %s, frame %u column %u: %u against %.1f\n", Avg_Name[a], k, c, FFT_Avg[c], ref[c]);
+        }
+      }
+      if (FFT_Frames != k) {
+        printf("t_avg: %s, frame %u counts %u\n", Avg_Name[a], k, FFT_Frames);
+        fails++;
+      }
+    }
+    printf("t_avg: %-8s %d frames, worst %.2f of 1/16, allowed %.0f\n", Avg_Name[a], FRAMES, worst, bound);
+  }
+
+  // a change in the key restarts with the next frame, weight 1/1, and so
+  // does the change back; other settings leave the average running
+  Item_Index[FFT_AVG] = 2;
+  for (i = 0; i < N_CHANGES; i++) {
+    for (k = 0; k < 20; k++) Frame(k);
+    frames = FFT_Frames;
+    v = Item_Index[Changes[i].Item];
+    Item_Index[Changes[i].Item] = Changes[i].Value;
+    Frame(0);
+    Item_Index[Changes[i].Item] = v;
+    Frame(STEP);
+    for (k = c = 0; c < FFT_COLS; c++)
+      if (FFT_Avg[c] != ((H[c] > 0xfff) ? 0xfff : H[c]) << 4) k++;
+    if (Changes[i].Key ? (FFT_Frames != 1) || k : (FFT_Frames != frames + 2)) {
+      printf("t_avg: a change of %s %s the average, %u frames and %u columns off the last frame\n",
+             Changes[i].Name, Changes[i].Key ? "does not restart" : "restarts", FFT_Frames, k);
+      fails++;
+    }
+  }
+
+  // and so do FFT_Avg_Reset and a move of the zoom center
+  Frame(0);
+  FFT_Avg_Reset();
+  Frame(STEP);
+  if (FFT_Frames != 1) {
+    printf("t_avg: FFT_Avg_Reset does not restart the average\n");
+    fails++;
+  }
+  Frame(0);
+  FFT_Move_Center(3);
+  Frame(STEP);
+  if (FFT_Frames != 1) {
+    printf("t_avg: FFT_Move_Center does not restart the average\n");
+    fails++;
+  }
+  printf("t_avg: %u setting changes, %u failures\n", (unsigned)N_CHANGES, fails);
+  return fails != 0;
+}
+/********************************* END OF FILE ********************************/
@@ -0,0 +1,138 @@
+/*******************************************************************************
+ File name  : t_counter.c
+ Description : host check of the frequency counter: TIM2 simulated at 72MHz
+               with its overflows, CH1 captures, the prescaler and a random
+               interrupt latency, the 1ms tick and the main loop poll drive
+               Counter_Capture, Counter_Tick and Counter_Poll. Every reading
+               within one tick over the gate and the display rounding, the
+               gate over whole periods of at least its time, no reading from
+               a gate without a period, PA0 analog while no gate is armed
+ *******************************************************************************/
+#include "host.h"
+#include "HW_V1_Config.h"
+
+// the registers Function.c touches for the counter, as plain words
+static vu32 Reg_DIER, Reg_SR, Reg_CCMR1, Reg_CCER, Reg_ARR, Reg_CRL;
+#undef TIM2_DIER
+#undef TIM2_SR
+#undef TIM2_CCMR1
+#undef TIM2_CCER
+#undef TIM2_ARR
+#undef GPIOA_CRL
+#define TIM2_DIER  Reg_DIER
+#define TIM2_SR    Reg_SR
+#define TIM2_CCMR1 Reg_CCMR1
+#define TIM2_CCER  Reg_CCER
+#define TIM2_ARR   Reg_ARR
+#define GPIOA_CRL  Reg_CRL
+
+#include "../source/Function.c"
+
+#define MS 72000LL   // ticks
+
+static int Fails;
+
+static void Fail(const char *what, double f, int g, unsigned int wrap)
+{
+  printf("t_counter: %.4f Hz, gate %d ms, wrap %u: %s\n", f, Gate_Time[g], wrap, what);
+  Fails++;
+}
+
+// f Hz (0 for none) through gate g for about span ms, TIM2 wrapping every
+// wrap ticks; returns the readings checked
+static int Run(double f, int g, unsigned int wrap, long long span)
+{
+  long long now = 0, wrap_at = wrap, tick_at = MS, isr_at = -1, poll_at = -1, edge_at, k = 0, end = span * MS;
+  double p = f ? 72e6 / f : 0, ph = (rand() % 1000) * 0.001 * p + 0.37;
+  unsigned int div = 0, ccr = 0, pend = 0, readings = 0, closes = 0, s, over, edges;
+  double err, bound, t;
+
+  Reg_ARR = wrap - 1;
+  Reg_CRL = 0x44444440;
+  Counter_Start(g);
+  Counter.Ovf = 0xFFFFFFFFu / wrap - 20;   // the timestamps wrap 2^32 early on
+  if ((Reg_CRL & 0xF) != 4) Fail("PA0 not digital at the start", f, g, wrap);
+
+  while (now < end) {
+    edge_at = f ? (long long)(ph + k * p) : end;
+    now = edge_at;
+    if (wrap_at < now) now = wrap_at;
+    if (tick_at < now) now = tick_at;
+    if ((isr_at >= 0) && (isr_at < now)) now = isr_at;
+    if ((poll_at >= 0) && (poll_at < now)) now = poll_at;
+
+    if (now == isr_at) {   // TIM2_IRQHandler
+      isr_at = -1;
+      if (Reg_DIER & 3) Counter_Capture(pend, ccr);
+      pend = 0;
+    } else if (now == wrap_at) {
+      wrap_at += wrap;
+      pend |= 0x0001;
+    } else if (now == tick_at) {
+      tick_at += MS;
+      Counter_Tick();
+    } else if (now == poll_at) {   // the main loop
+      poll_at = -1;
+      if ((Reg_CRL & 0xF) != 0) Fail("PA0 still digital after the gate", f, g, wrap);
+      over = Counter.Over;
+      edges = Counter.Edges;
+      Counter_Poll();
+      if ((Reg_CRL & 0xF) != 4) Fail("PA0 not digital with the gate armed", f, g, wrap);
+      closes++;
+      s = Counter.Last - Counter.First;
+      if (!Counter_Freq) {
+        if (!over && (edges >= 2)) Fail("no reading from whole periods", f, g, wrap);
+        if ((p > 0) && (p < (Gate_Time[g] + CNT_TIMEOUT - 1) * MS) && !over)
+          Fail("no reading from a signal faster than the timeout", f, g, wrap);
+        continue;
+      }
+      if (!f || (p > (Gate_Time[g] + CNT_TIMEOUT + 1) * MS)) {
+        Fail("a reading without a period inside the timeout", f, g, wrap);
+        continue;
+      }
+      if (s < (Gate_Time[g] - 1) * MS) Fail("gate shorter than its time", f, g, wrap);
+      if (s > (Gate_Time[g] + 1) * MS + p * 8) Fail("gate longer than its time and a period", f, g, wrap);
+      err = fabs(Counter_Freq / 1000.0 - f);
+      bound = f / (s - 1) + 0.0005;
+      if (err > bound) Fail("frequency beyond one tick and the last digit", f, g, wrap);
+      t = Counter_Period * (Counter_TUnit ? 1000.0 : 1.0);
+      err = fabs(t - 1e12 / f);
+      bound = 1e12 / f / (s - 1) + (Counter_TUnit ? 500 : 0.5);
+      if (err > bound) Fail("period beyond one tick and the last digit", f, g, wrap);
+      readings++;
+    } else {   // an edge at the input
+      k++;
+      if (((Reg_CRL & 0xF) == 4) && (Reg_CCER & 1) && ((div++ & ((1 << Counter.Psc) - 1)) == 0)) {
+        if (pend & 0x0002) pend |= 0x0200;   // CC1OF
+        pend |= 0x0002;
+        ccr = (unsigned int)(now % wrap);
+      } else
+        continue;
+    }
+    if (pend && (isr_at < 0)) isr_at = now + 12 + rand() % 60;   // latency, ticks
+    if ((Counter.State == CNT_DONE) && (poll_at < 0)) poll_at = now + MS / 4 + rand() % (4 * MS);
+  }
+  Counter_Start(0);
+  if ((Reg_CRL & 0xF) != 0) Fail("PA0 not analog after the stop", f, g, wrap);
+  if (closes == 0) Fail("no gate closed", f, g, wrap);
+  return readings;
+}
+
+int main(int argc, char **argv)
+{
+  static const double Freq[] = {0, 0.4, 1.7, 49.99, 1000, 12345.6, 33333.3, 777777.7, 2e6};
+  static const unsigned int Wrap[] = {3600, 65536};
+  unsigned int i, g, w, n = 0, span;
+
+  srand(33);
+  for (i = 0; i < sizeof(Freq) / sizeof(Freq[0]); i++)
+    for (g = 1; g < 4; g++)
+      for (w = 0; w < 2; w++) {
+        span = 3 * (Gate_Time[g] + CNT_TIMEOUT) + 3000;
+        if ((Freq[i] > 1e5) && (g == 3)) span = 25000;
+        n += Run(Freq[i], g, Wrap[w], span);
+      }
+  printf("t_counter: %u readings, %d failures\n", n, Fails);
+  return Fails != 0;
+}
+/********************************* END OF FILE ********************************/
@@ -0,0 +1,130 @@
+/*******************************************************************************
+ File name  : t_fft.c
+ Description : host check of the real FFT: n windowed real samples packed
+               into an n / 2 point complex FFT and split by Real_Spectrum,
+               against a double DFT of the same FFT input, at each size and
+               window, from a t0 where the record wraps, the largest size
+               through its four quarters and FFT_Combine. Tones on a bin
+               come out largest in that bin at each size and window. -b
+               times the split and magnitudes against the magnitudes of an n
+               point complex FFT of the same samples, the transforms left
+               out, and FFT_Combine
+ *******************************************************************************/
+#include <time.h>
+#include "host.h"
+#include "../source/Function.c"
+
+static double Now(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static volatile unsigned int Sink;   // keeps the reference magnitudes
+
+static int Bench(void)
+{
+  static int x[2 * FFT_MAX];
+  int sz, n, m, i, k, reps = 20000, *z;
+  double t1, t2;
+  unsigned int s = 0;
+
+  for (sz = 0; sz < N_FFT_SIZE; sz++) {
+    n = FFT_Size[sz];
+    m = n / 2;
+    z = (m > FFT_PART) ? FFT_in : FFT_out;   // the largest splits in place
+    for (i = 0; i < n; i++) x[i] = ((rand() % 8001 - 4000) << 16) | ((rand() % 8001 - 4000) & 0xffff);
+    t1 = Now();
+    for (k = 0; k < reps; k++) {
+      memcpy(z, x, m * 4);
+      Real_Spectrum(z, m);
+    }
+    t1 = (Now() - t1) / reps;
+    t2 = Now();
+    for (k = 0; k < reps; k++)
+      for (i = 0; i < m; i++) s += Magnitude((short)x[i], x[i] >> 16);   // bins 0 .. n / 2 - 1 of n
+    t2 = (Now() - t2) / reps;
+    Sink = s;
+    printf("t_fft: %4d real points, split and %d magnitudes %.2f us, %d magnitudes of a %d point FFT %.2f us\n",
+           n, m, t1 * 1e6, m, n, t2 * 1e6);
+  }
+  t1 = Now();
+  for (k = 0; k < reps; k++) {
+    memcpy(FFT_in, x, sizeof(FFT_in));
+    FFT_Combine();
+  }
+  t1 = (Now() - t1) / reps;
+  printf("t_fft: four %d point quarters joined into %d points %.2f us\n", FFT_PART, FFT_MAX, t1 * 1e6);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  static short xin[2 * FFT_MAX];
+  int sz, w, trial, n, m, i, j, k, b, missed, fails = 0;
+  double f1, f2, v, re, im, ref, e, worst, peak;
+
+  if ((argc > 1) && !strcmp(argv[1], "-b")) return Bench();
+  t0 = 2900;   // the record wraps inside the largest FFT
+  Item_Index[X_SENSITIVITY] = 10;
+  for (sz = 0; sz < N_FFT_SIZE; sz++) {
+    n = FFT_Size[sz];
+    m = n / 2;
+    worst = peak = 0;
+    Item_Index[FFT_SIZE] = sz;
+    for (w = 0; w < N_FFT_WINDOW; w++)
+      for (trial = 0; trial < 6; trial++) {
+        Item_Index[FFT_WINDOW] = w;
+        srand(trial * 7 + w + sz * 100);
+        f1 = 3 + rand() % (m - 6) + rand() / (double)RAND_MAX;
+        f2 = 2 + rand() % (m - 4);
+        for (i = 0; i < BUFFER_SIZE; i++) {
+          j = (i - t0 + BUFFER_SIZE) % BUFFER_SIZE;
+          v = 2048 + 900 * cos(2 * M_PI * f1 * j / n + trial) + 300 * sin(2 * M_PI * f2 * j / n)
+              + (((j / 37) & 1) ? 200 : -200) * (trial & 1) + (rand() % 41 - 20);
+          Scan_Buffer[i] = (v < 0) ? 0 : (v > 4095) ? 4095 : lround(v);
+        }
+        FFT_Window();
+        FFT_Step();   // FFT_WEIGHT, the windowed input
+        for (i = 0; i < n; i++) xin[i] = ((short *)FFT_in)[(m > FFT_PART) ? FFT_SLOT(i) : i];
+        FFT_Finish();
+        for (k = 0; k < m; k++) {
+          for (re = im = 0, i = 0; i < n; i++) {
+            re += xin[i] * cos(2 * M_PI * k * i / n);
+            im -= xin[i] * sin(2 * M_PI * k * i / n);
+          }
+          ref = 2 * hypot(re, im) / n;   // as an n / 2 point FFT / N scales it
+          e = fabs(FFT_mag[k] - ref);
+          if (e > worst) worst = e;
+          if (ref > peak) peak = ref;
+        }
+      }
+    printf("t_fft: %4d real points through a %3d point complex FFT, %d bins, worst |bin - DFT| %.2f of a peak of %.0f\n",
+           n, m, m, worst, peak);
+    if (worst > 3) fails++;
+
+    // a tone on bin k lands there, across the band and at the edges
+    missed = 0;
+    for (w = 0; w < N_FFT_WINDOW; w++)
+      for (k = 6; k < m - 6; k += (k < m / 2) ? m / 16 + 1 : m / 16 - 1) {
+        Item_Index[FFT_WINDOW] = w;
+        for (i = 0; i < BUFFER_SIZE; i++)
+          Scan_Buffer[(i + t0) % BUFFER_SIZE] = lround(2048 + 1200 * cos(2 * M_PI * k * i / n + 0.4 * k));
+        FFT_Window();
+        FFT_Finish();
+        for (b = 1, i = 2; i < m; i++)
+          if (FFT_mag[i] > FFT_mag[b]) b = i;
+        if (b != k) {
+          printf("t_fft: %d points, window %d, tone on bin %d peaks in bin %d\n", n, w, k, b);
+          missed++;
+        }
+      }
+    printf("t_fft: %4d real points, tones on a bin at each window, %d in the wrong bin\n", n, missed);
+    fails += missed;
+  }
+  printf("t_fft: %d failures\n", fails);
+  return fails != 0;
+}
+/********************************* END OF FILE ********************************/
@@ -0,0 +1,377 @@
+/*******************************************************************************
+ File name  : t_format.c
+ Description : host check of Int32String and Int32String_sign against the
+               former formatters: every digit count and rounding edge, a
+               sweep over the 32 bit range (all of it with -x) for 3, 4 and
+               6 digits and a sparser one for 0..9, and the band where the
+               former signed path overflowed int while rounding, against
+               its unsigned path and explicit values. -b times both
+ *******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "Calculate.h"
+
+// the former formatters, a divide loop for the digit count and the digits
+static void Old_Int32String_sign(I32STR_RES * r, int n, unsigned char e)
+{
+   unsigned int   m, c;
+   unsigned char  i, fixlen;
+   char           *p = r->str;
+
+   fixlen = e + 2;
+   if (n == 0)
+   {
+      *p++ = ' ';
+      *p++ = '0';
+      *p++ = '.';
+      *p++ = '0';
+      *p++ = '0';
+      *p = 0;
+      r->decPos = 0;
+      r->len = p - r->str;
+      return;
+   }
+   if (n > 0)
+      *p++ = ' ';
+   else
+   {
+      *p++ = '-';
+      n = -n;
+   }
+   m = n;
+   i = 0;
+   c = 5;
+   while (m >= 10)
+   {
+      m /= 10;
+      if (++i > e)
+         c *= 10;
+   }
+   if (i >= e) {
+      n += c;
+      m = n;
+      i = 0;
+      while (m >= 10) m /= 10, i++;
+   }
+   r->decPos = i / 3;
+   switch (i)
+   {
+   case 9:
+      *p++ = '0' + n / 1000000000;
+      if (--e == 0)
+         break;
+      n %= 1000000000;
+      *p++ = '.', i = 0;
+   case 8:
+      *p++ = '0' + n / 100000000;
+      if (--e == 0)
+         break;
+      n %= 100000000;
+   case 7:
+      *p++ = '0' + n / 10000000;
+      if (--e == 0)
+         break;
+      n %= 10000000;
+   case 6:
+      *p++ = '0' + n / 1000000;
+      if (--e == 0)
+         break;
+      n %= 1000000;
+      if (i)
+         *p++ = '.', i = 0;
+   case 5:
+      *p++ = '0' + n / 100000;
+      if (--e == 0)
+         break;
+      n %= 100000;
+   case 4:
+      *p++ = '0' + n / 10000;
+      if (--e == 0)
+         break;
+      n %= 10000;
+   case 3:
+      *p++ = '0' + n / 1000;
+      if (--e == 0)
+         break;
+      n %= 1000;
+      if (i)
+         *p++ = '.', i = 0;
+   case 2:
+      *p++ = '0' + n / 100;
+      if (--e == 0)
+         break;
+      n %= 100;
+   case 1:
+      *p++ = '0' + n / 10;
+      if (--e == 0)
+         break;
+      n %= 10;
+   case 0:
+      *p++ = '0' + n;
+   }
+
+   while (p < r->str + fixlen) {
+     char *q = p;
+     while (q > r->str) {
+       *q = *(q - 1);
+       q--;
+     }
+     *q = ' ';
+     p++;
+   }
+//   while (p < r->str + fixlen)
+//      *p++ = ' ';
+   *p = 0;
+   r->len = p - r->str;
+}
+
+static void Old_Int32String(I32STR_RES * r, unsigned int n, unsigned char e)
+{
+   unsigned int   m, c;
+   unsigned char  i, fixlen;
+   char           *p = r->str;
+
+   fixlen = e + 1;
+   if (n == 0)
+   {
+      *p++ = '0';
+      *p++ = '.';
+      *p++ = '0';
+      *p++ = '0';
+      //*p++ = '0';
+      *p = 0;
+      r->decPos = 0;
+      r->len = p - r->str;
+      return;
+   }
+   m = n;
+   i = 0;
+   c = 5;
+   while (m >= 10)
+   {
+      m /= 10;
+      if (++i > e)
+         c *= 10;
+   }
+   if (i >= e) {
+      n += c;
+      m = n;
+      i = 0;
+      while (m >= 10) m /= 10, i++;
+   }
+   r->decPos = i / 3;
+   switch (i)
+   {
+   case 9:
+      *p++ = '0' + n / 1000000000;
+      if (--e == 0)
+         break;
+      n %= 1000000000;
+      *p++ = '.', i = 0;
+   case 8:
+      *p++ = '0' + n / 100000000;
+      if (--e == 0)
+         break;
+      n %= 100000000;
+   case 7:
+      *p++ = '0' + n / 10000000;
+      if (--e == 0)
+         break;
+      n %= 10000000;
+   case 6:
+      *p++ = '0' + n / 1000000;
+      if (--e == 0)
+         break;
+      n %= 1000000;
+      if (i)
+         *p++ = '.', i = 0;
+   case 5:
+      *p++ = '0' + n / 100000;
+      if (--e == 0)
+         break;
+      n %= 100000;
+   case 4:
+      *p++ = '0' + n / 10000;
+      if (--e == 0)
+         break;
+      n %= 10000;
+   case 3:
+      *p++ = '0' + n / 1000;
+      if (--e == 0)
+         break;
+      n %= 1000;
+      if (i)
+         *p++ = '.', i = 0;
+   case 2:
+      *p++ = '0' + n / 100;
+      if (--e == 0)
+         break;
+      n %= 100;
+   case 1:
+      *p++ = '0' + n / 10;
+      if (--e == 0)
+         break;
+      n %= 10;
+   case 0:
+      *p++ = '0' + n;
+   }
+   while (p < r->str + fixlen) {
+     char *q = p;
+     while (q > r->str) {
+       *q = *(q - 1);
+       q--;
+     }
+     *q = ' ';
+     p++;
+   }
+//   while (p < r->str + fixlen)
+//      *p++ = ' ';
+   *p = 0;
+   r->len = p - r->str;
+}
+
+static unsigned int Bad;
+
+// the sign is printed after the padding, as the digits of the unsigned path
+static void Signed_Ref(I32STR_RES *r, int n, unsigned char e)
+{
+  I32STR_RES u;
+  unsigned char k;
+
+  Old_Int32String(&u, (n < 0) ? 0 - (unsigned int)n : n, e);
+  for (k = 0; u.str[k] == ' '; k++);
+  memset(r->str, ' ', k);
+  r->str[k] = (n < 0) ? '-' : ' ';
+  strcpy(r->str + k + 1, u.str + k);
+  r->len = u.len + 1;
+  r->decPos = u.decPos;
+}
+
+static void Same(const I32STR_RES *a, const I32STR_RES *b, const char *what, unsigned int n, unsigned char e)
+{
+  if (!strcmp(a->str, b->str) && (a->len == b->len) && (a->decPos == b->decPos)) return;
+  if (Bad++ < 10)
+    printf("t_format: %s %u, %d digits: '%s' %d %d, want '%s' %d %d\n",
+           what, n, e, a->str, a->len, a->decPos, b->str, b->len, b->decPos);
+}
+
+// the smallest magnitude whose rounding overflowed the former signed path
+static unsigned int Band(unsigned char e)
+{
+  unsigned int c = 5;
+
+  for (; e < 9; e++) c *= 10;
+  return 0x7FFFFFFFu - c + 1;
+}
+
+static void Check(unsigned int n, unsigned char e)
+{
+  I32STR_RES a, b;
+  int s = n;
+
+  // the former unsigned path wrapped as well above 2^32 - 5 * 10^(9 - e),
+  // beyond CNT_MAX; both print the same there
+  Int32String(&a, n, e);
+  Old_Int32String(&b, n, e);
+  Same(&a, &b, "unsigned", n, e);
+
+  Int32String_sign(&a, s, e);
+  if ((s == (int)0x80000000) || (((s < 0) ? 0 - (unsigned int)s : (unsigned int)s) >= Band(e)))
+    Signed_Ref(&b, s, e);
+  else
+    Old_Int32String_sign(&b, s, e);
+  Same(&a, &b, "signed", n, e);
+}
+
+static double Now(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static int Bench(void)
+{
+  static const unsigned char E[3] = {3, 4, 6};
+  volatile unsigned int s = 0;
+  unsigned int i, k, n = 0;
+  I32STR_RES r;
+  double t1, t2;
+
+  for (k = 0; k < 3; k++) {
+    t1 = Now();
+    for (i = 1, n = 0; i < 0x7FFFFFFF / 2; i += 1997 + (i >> 4), n++) {   // log spaced
+      Int32String(&r, i, E[k]);
+      s += r.len;
+    }
+    t1 = (Now() - t1) / n;
+    t2 = Now();
+    for (i = 1; i < 0x7FFFFFFF / 2; i += 1997 + (i >> 4)) {
+      Old_Int32String(&r, i, E[k]);
+      s += r.len;
+    }
+    t2 = (Now() - t2) / n;
+    printf("t_format: %d digits, Int32String %.1f ns, former %.1f ns a call\n", E[k], t1 * 1e9, t2 * 1e9);
+  }
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  // the former signed path printed garbage for these
+  static const struct { int n; unsigned char e; const char *s; } Band_Case[] = {
+    { 2147483647, 3, " 2.15"},    {-2147483647 - 1, 3, "-2.15"},
+    { 2142483648, 3, " 2.14"},    {-2142483648, 3, "-2.14"},
+    { 2145000000, 3, " 2.15"},    {-2144999999, 3, "-2.14"},
+    { 2147483647, 4, " 2.147"},   {-2147483647 - 1, 4, "-2.147"},
+    { 2146983648, 4, " 2.147"},   {-2146983648, 4, "-2.147"},
+    { 2147483647, 6, " 2.14748"}, {-2147483647 - 1, 6, "-2.14748"},
+    { 2147483148, 6, " 2.14748"}, {-2147483148, 6, "-2.14748"},
+  };
+  static const unsigned char E[3] = {3, 4, 6};
+  unsigned long long n, p, step = 997;
+  unsigned int i, k, d, sweeps = 0;
+  unsigned char e;
+  I32STR_RES r;
+
+  if ((argc > 1) && !strcmp(argv[1], "-b")) return Bench();
+  if ((argc > 1) && !strcmp(argv[1], "-x")) step = 1;
+
+  // both sides of every power of ten and of every rounding step
+  for (e = 0; e <= 9; e++)
+    for (p = 1; p <= 1000000000; p *= 10)
+      for (d = 1; d <= 9; d++)
+        for (k = 0; k < 2; k++) {
+          n = d * p + (k ? p / 2 : 0);
+          if (n > 0xFFFFFFFFULL) continue;
+          for (i = 0; i < 5; i++)
+            if ((n + i >= 2) && (n + i - 2 <= 0xFFFFFFFFULL)) Check(n + i - 2, e);
+        }
+
+  for (k = 0; k < 3; k++, sweeps++)
+    for (n = 0; n <= 0xFFFFFFFFULL; n += step) Check(n, E[k]);
+  for (e = 0; e <= 9; e++)
+    for (n = 0; n <= 0xFFFFFFFFULL; n += 99991) Check(n, e);
+
+  // the overflow band of the former signed path, whole
+  for (k = 0; k < 3; k++)
+    for (n = Band(E[k]); n <= 0x80000000ULL; n++) {
+      Check(n, E[k]);
+      Check(0 - (unsigned int)n, E[k]);
+    }
+  for (i = 0; i < sizeof(Band_Case) / sizeof(Band_Case[0]); i++) {
+    Int32String_sign(&r, Band_Case[i].n, Band_Case[i].e);
+    if (strcmp(r.str, Band_Case[i].s) || (r.len != strlen(Band_Case[i].s)) || (r.decPos != 3)) {
+      printf("t_format: %d, %d digits: '%s', want '%s'\n", Band_Case[i].n, Band_Case[i].e, r.str, Band_Case[i].s);
+      Bad++;
+    }
+  }
+
+  printf("t_format: %s for 3, 4 and 6 digits and the signed overflow band, %u differences, %u failures\n",
+         (step == 1) ? "all 2^32 inputs" : "edges and a sweep", Bad, Bad);
+  return Bad != 0;
+}
+/********************************* END OF FILE ********************************/
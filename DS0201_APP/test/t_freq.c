@@ -0,0 +1,93 @@
+/*******************************************************************************
+ File name  : t_freq.c
+ Description : host check of the frequency and duty measures: sines and
+               50..80% trapezoids with 3 sample ramps, +-2 LSB noise, at
+               3.3 to 203 cycles in the record and every timebase, 40 runs
+               each. The frequency within the least squares bound for its
+               cycle count and 1 mHz, the duty within 0.035%, 0.05% at 3.3
+               cycles
+ *******************************************************************************/
+#include "host.h"
+#include "../source/Function.c"
+
+static const double Cycles[4] = {3.3, 10.7, 41.9, 203};
+static const double Bound[4]  = {400e-6, 60e-6, 6e-6, 2e-6};   // relative frequency error
+// duty, 1/1000 %. A sine of 3.3 cycles crosses Threshold3 at about 10 LSB a
+// sample, the noise moves each of its 6 crossings by 0.14 sample rms
+static const int Duty_Bound[4] = {50, 35, 35, 35};
+
+typedef struct { int sine; double per, ph, c, a, d; } SigType;
+
+static double Frand(void) { return rand() / (RAND_MAX + 1.0); }
+
+// ADC value at sample time t, the low ADC value is the signal high
+static double Sig(const SigType *g, double t)
+{
+  double x = fmod(t + g->ph, g->per), hi = g->d * g->per;
+
+  if (g->sine) return g->c + g->a * cos(2 * M_PI * x / g->per);
+  if (x < 3) return g->c + g->a * (1 - 2 * x / 3);
+  if (x < hi) return g->c - g->a;
+  if (x < hi + 3) return g->c + g->a * (2 * (x - hi) / 3 - 1);
+  return g->c + g->a;
+}
+
+// time the signal spends below th, 1/1000 % of a period
+static double Below(const SigType *g, double th)
+{
+  int i, k = 0, n = 200000;
+
+  for (i = 0; i < n; i++) k += Sig(g, g->per * (i + 0.5) / n) < th;
+  return 100000.0 * k / n;
+}
+
+int main(void)
+{
+  double fs, f, e, wf[4] = {0}, wd[4] = {0}, duty;
+  int c, tb, run, i, fails = 0;
+  SigType g;
+
+  srand(32);
+  Item_Index[SYNC_MODE] = 2;          // SING, no auto range
+  Item_Index[FFT_HARM] = FFT_VIEW_OFF;
+  Item_Index[Y_SENSITIVITY] = 3;
+  Item_Index[CALIBRATE_OFFSET] = Item_Index[CALIBRATE_RANGE] = 100;
+  Item_Index[V0] = 100;
+  Item_Index[VT] = 120;
+  Item_Index[TRIG_SENSITIVITY] = 3;
+  for (c = 0; c < 4; c++)
+    for (tb = 0; tb < 22; tb++)
+      for (run = 0; run < 40; run++) {
+        Item_Index[X_SENSITIVITY] = tb;
+        fs = 72e6 / ((Scan_PSC[tb] + 1.0) * (Scan_ARR[tb] + 1));
+        g.sine = run & 1;
+        g.per = BUFFER_SIZE / (Cycles[c] * (0.97 + 0.06 * Frand()));
+        g.ph = Frand() * g.per;
+        g.c = SigToAdc(Item_Index[VT]);
+        g.a = 1200 + Frand() * 600;
+        g.d = 0.5 + 0.3 * Frand();
+        tp_to_abs = rand() % BUFFER_SIZE;
+        for (i = 0; i < BUFFER_SIZE; i++)
+          Scan_Buffer[(i + tp_to_abs) % BUFFER_SIZE] = lrint(Sig(&g, i)) + rand() % 5 - 2;
+        Measure_Wave();
+        if (!MeFr) {
+          printf("t_freq: %.1f cycles, timebase %d: no frequency\n", Cycles[c], tb);
+          fails++;
+          continue;
+        }
+        f = fs / g.per * 1000;   // mHz
+        e = fabs(Frequency - f);
+        if (e > Bound[c] * f + 1) fails++;
+        if ((e - 1) / f > wf[c]) wf[c] = (e - 1) / f;
+        duty = Below(&g, SigToAdc(Item_Index[VT]));
+        e = fabs(Duty - duty);
+        if (e > Duty_Bound[c]) fails++;
+        if (e > wd[c]) wd[c] = e;
+      }
+  for (c = 0; c < 4; c++)
+    printf("t_freq: %5.1f cycles, worst frequency %6.1f ppm beyond 1 mHz (bound %3.0f), duty %.3f%% (bound %.3f%%)\n",
+           Cycles[c], wf[c] * 1e6, Bound[c] * 1e6, wd[c] / 1000, Duty_Bound[c] / 1000.0);
+  printf("t_freq: %d failures\n", fails);
+  return fails != 0;
+}
+/********************************* END OF FILE ********************************/
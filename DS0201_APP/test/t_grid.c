@@ -0,0 +1,325 @@
+/*******************************************************************************
+ File name  : t_grid.c
+ Description : host check of the graticule against the former Display_Grid
+               on a model of the LCD controller's GRAM, pixel by pixel: the
+               whole grid over random GRAM, Display_Grid_Area over random
+               rectangles, and closing a popup with waves and reference
+               updated under it, the area repair of HidePopup against the
+               former full redraw. -b counts the bus cycles of both
+ *******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stm32f10x_lib.h"
+#include "HW_V1_Config.h"
+
+// the LCD bus drives the GRAM model instead of the ports
+static unsigned short Bus, Rs = 1;
+static void Strobe(void);
+#undef LDC_DATA_OUT
+#undef LCD_RS_LOW
+#undef LCD_RS_HIGH
+#undef LCD_nWR_ACT
+#define LDC_DATA_OUT  Bus
+#define LCD_RS_LOW()  (Rs = 0)
+#define LCD_RS_HIGH() (Rs = 1)
+#define LCD_nWR_ACT() Strobe()
+
+#include "../source/Lcd.c"
+
+unsigned short Item_Index[N_ITEM];
+PopupType      Popup;
+LIB_Interface  *pLib;
+unsigned char  View_Buffer[300], Erase_Buffer[300], Ref_Buffer[304];
+
+static unsigned short Gram[LCD_HEIGHT][LCD_WIDTH], Reg[256], Index, Ac_x, Ac_y;
+static unsigned int   Strobes, Data_Writes, Reg_Writes;
+
+// ILI9325 as the firmware sets it up: R20 the row (y), R21 the column (x),
+// R50..R53 the window, GRAM writes step y first
+static void Strobe(void)
+{
+  Strobes++;
+  if (!Rs) {
+    Index = Bus & 0xff;
+    return;
+  }
+  if (Index != 0x22) {
+    Reg[Index] = Bus;
+    Reg_Writes++;
+    if (Index == 0x20) Ac_y = Bus;
+    if (Index == 0x21) Ac_x = Bus;
+    return;
+  }
+  Data_Writes++;
+  if ((Ac_x < LCD_WIDTH) && (Ac_y < LCD_HEIGHT)) Gram[Ac_y][Ac_x] = Bus;
+  if (Ac_y++ >= Reg[0x51]) {
+    Ac_y = Reg[0x50];
+    if (Ac_x++ >= Reg[0x53]) Ac_x = Reg[0x52];
+  }
+}
+
+// the pixel read-modify-writes of ASM_Function.s, on the model
+void __Add_Color(u16 x, u16 y, u16 Color)
+{
+  unsigned short p = Gram[y][x];
+
+  if (!(p & C_GROUP) || (Color & C_GROUP))
+    p = (p & F_SELEC) | Color;
+  else
+    p |= Color & F_SELEC;
+  Gram[y][x] = p;
+}
+
+void __Erase_Color(u16 x, u16 y, u16 Color)
+{
+  unsigned short p = Gram[y][x] & F_SELEC;
+
+  if (!(p & Color)) return;
+  p &= ~(Color & F_SELEC);
+  if (p & WAV_FLAG) p |= WAV_COLOR;
+  else if (p & CH2_FLAG) p |= CH2_COLOR;
+  else if (p & REF_FLAG) p |= REF_COLOR;
+  else if (p & LN1_FLAG) p |= LN1_COLOR;
+  else if (p & LN2_FLAG) p |= LN2_COLOR;
+  else if (p & GRD_FLAG) p |= GRD_COLOR;
+  Gram[y][x] = p;
+}
+
+// the former Display_Grid, a fill and then every grid pixel on its own
+static void Old_Display_Grid(void)
+{
+   unsigned short  i, j;
+   short n;
+
+   // grid background + outside frame
+   Fill_Rectangle(MIN_X - 1, MIN_Y - 1, X_SIZE + 2, Y_SIZE + 2, BACKGROUND);
+
+   // horizontal frame
+   for (i = MIN_X; i <= MAX_X; i++) {
+      Point_SCR(i, MIN_Y);
+      Set_Pixel(GRD_COLOR);
+      Point_SCR(i, MAX_Y);
+      Set_Pixel(GRD_COLOR);
+     if ((((i - MIN_X) % 5) == 0) && (i != MIN_X) && (i != MAX_X)) {
+       for (n = 1; n <= 2; n++) {
+          Point_SCR(i, MIN_Y + n);
+          Set_Pixel(GRD_COLOR);
+          Point_SCR(i, MAX_Y - n);
+          Set_Pixel(GRD_COLOR);
+       }
+     }
+   }
+
+   // vertical frame
+   for (j = MIN_Y + 1; j <= (MAX_Y - 1); j++) {
+      Point_SCR(MIN_X, j);
+      Set_Pixel(GRD_COLOR);
+      Point_SCR(MAX_X, j);
+      Set_Pixel(GRD_COLOR);
+     if (((j - MIN_Y) % 5) == 0) {
+       for (n = 1; n <= 2; n++) {
+          Point_SCR(MIN_X + n, j);
+          Set_Pixel(GRD_COLOR);
+          Point_SCR(MAX_X - n, j);
+          Set_Pixel(GRD_COLOR);
+       }
+     }
+   }
+
+   // horizontal grid lines
+   for (j = MIN_Y + 25; j <= (MAX_Y - 25 + 1); j += 25)
+   {
+      for (i = MIN_X + 5; i <= (MAX_X - 5 + 1); i += 5)
+      {
+         if (j == (MIN_Y + Y_SIZE / 2)) {
+           for (n = -1; n <= 1; n++) {
+             Point_SCR(i, j + n);
+             Set_Pixel(GRD_COLOR);
+           }
+         } else {
+           Point_SCR(i, j);
+           Set_Pixel(GRD_COLOR);
+         }
+      }
+   }
+   // vertical grid lines
+   for (i = MIN_X + 25; i <= (MAX_X - 25 + 1); i += 25)
+   {
+      for (j = MIN_Y + 5; j <= (MAX_Y - 5 + 1); j += 5)
+      {
+         if (i == (MIN_X + X_SIZE / 2)) {
+           for (n = -1; n <= 1; n++) {
+             Point_SCR(i + n, j);
+             Set_Pixel(GRD_COLOR);
+           }
+         } else {
+           Point_SCR(i, j);
+           Set_Pixel(GRD_COLOR);
+         }
+      }
+   }
+}
+
+// the former HidePopup, the whole grid and all columns again
+static void Old_Hide(void)
+{
+  unsigned short i, j;
+
+  Popup.Active = 0;
+  Old_Display_Grid();
+  for (i = 0; i < X_SIZE; i++) Draw_SEG(i, Erase_Buffer[i], View_Buffer[i], WAV_COLOR);
+  for (j = i = 0; j < X_SIZE; j++) {
+    Draw_SEG(j, Ref_Buffer[i], Ref_Buffer[j], REF_COLOR);
+    i = j;
+  }
+}
+
+// HidePopup, the grid and the columns under the popup only
+static void Hide(void)
+{
+  unsigned short i, x1, x2;
+
+  Popup.Active = 0;
+  Display_Grid_Area(Popup.x, Popup.y, Popup.width, Popup.height);
+  x1 = Popup.x - MIN_X;
+  x2 = x1 + Popup.width;
+  if (x2 > X_SIZE) x2 = X_SIZE;
+  for (i = x1; i < x2; i++) Popup_SEG(i, Erase_Buffer[i], View_Buffer[i], WAV_COLOR);
+  for (i = x1; i < x2; i++) Popup_SEG(i, Ref_Buffer[i ? i - 1 : 0], Ref_Buffer[i], REF_COLOR);
+}
+
+static void Noise(void)
+{
+  int x, y;
+
+  for (y = 0; y < LCD_HEIGHT; y++)
+    for (x = 0; x < LCD_WIDTH; x++) Gram[y][x] = rand();
+}
+
+// a random walk in the grid, 0xff for a column without a sample
+static void Walk(unsigned char *b, int n)
+{
+  int i, y = MIN_Y + rand() % Y_SIZE;
+
+  for (i = 0; i < n; i++) {
+    y += rand() % 31 - 15;
+    y = (y < MIN_Y - 5) ? MIN_Y - 5 : (y > MAX_Y + 5) ? MAX_Y + 5 : y;
+    b[i] = (rand() % 50) ? y : 0xff;
+  }
+}
+
+// as Draw_Wave does it, the former segment erased and the new one drawn
+static void Wave(void)
+{
+  unsigned char w[X_SIZE];
+  unsigned short i;
+
+  Walk(w, X_SIZE);
+  for (i = 0; i < X_SIZE; i++) {
+    Erase_SEG(i, Erase_Buffer[i], View_Buffer[i], WAV_COLOR);
+    Draw_SEG(i, w[i ? i - 1 : 0], w[i], WAV_COLOR);
+    View_Buffer[i] = w[i];
+    Erase_Buffer[i] = w[i ? i - 1 : 0];
+  }
+}
+
+static unsigned short Old[LCD_HEIGHT][LCD_WIDTH], Start[LCD_HEIGHT][LCD_WIDTH];
+
+static int Bench(void)
+{
+  unsigned int s, d, r;
+
+  srand(28);
+  Noise();
+  Strobes = Data_Writes = Reg_Writes = 0;
+  Old_Display_Grid();
+  s = Strobes, d = Data_Writes, r = Reg_Writes;
+  Strobes = Data_Writes = Reg_Writes = 0;
+  Display_Grid();
+  printf("t_grid: whole grid, former %u strobes %u pixels %u registers, now %u %u %u\n",
+         s, d, r, Strobes, Data_Writes, Reg_Writes);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned int trial, x, y, grid = 0, bad = 0, n, w, h;
+  short x0, y0;
+
+  if ((argc > 1) && !strcmp(argv[1], "-b")) return Bench();
+  srand(28);
+
+  // the whole grid over random GRAM
+  Noise();
+  memcpy(Start, Gram, sizeof(Gram));
+  Old_Display_Grid();
+  memcpy(Old, Gram, sizeof(Gram));
+  memcpy(Gram, Start, sizeof(Gram));
+  Display_Grid();
+  for (n = y = 0; y < LCD_HEIGHT; y++)
+    for (x = 0; x < LCD_WIDTH; x++) {
+      n += Gram[y][x] != Old[y][x];
+      grid += (x >= MIN_X - 1) && (x <= MAX_X + 1) && (y >= MIN_Y - 1) && (y <= MAX_Y + 1) && (Old[y][x] == (GRD_COLOR));
+    }
+  printf("t_grid: whole grid, %u grid pixels, %u differ from the former one\n", grid, n);
+  bad += n;
+
+  // rectangles anywhere, clipped to the grid, the rest left alone
+  for (n = trial = 0; trial < 600; trial++) {
+    x0 = rand() % (LCD_WIDTH + 40) - 20;
+    y0 = rand() % (LCD_HEIGHT + 40) - 20;
+    w = rand() % 200;
+    h = rand() % 200;
+    Noise();
+    memcpy(Start, Gram, sizeof(Gram));
+    Display_Grid_Area(x0, y0, w, h);
+    for (y = 0; y < LCD_HEIGHT; y++)
+      for (x = 0; x < LCD_WIDTH; x++)
+        if (((int)x >= x0) && ((int)x < x0 + (int)w) && ((int)y >= y0) && ((int)y < y0 + (int)h) &&
+            (x >= MIN_X - 1) && (x <= MAX_X + 1) && (y >= MIN_Y - 1) && (y <= MAX_Y + 1))
+          n += Gram[y][x] != Old[y][x];
+        else
+          n += Gram[y][x] != Start[y][x];
+  }
+  printf("t_grid: %u rectangles, %u pixels differ\n", trial, n);
+  bad += n;
+
+  // a popup closed over waves and a reference drawn while it was open
+  for (n = trial = 0; trial < 300; trial++) {
+    Noise();
+    Display_Grid();
+    Walk(View_Buffer, X_SIZE);
+    Walk(Ref_Buffer, X_SIZE);
+    for (x = 0; x < X_SIZE; x++) {
+      Erase_Buffer[x] = View_Buffer[x ? x - 1 : 0];
+      Draw_SEG(x, Erase_Buffer[x], View_Buffer[x], WAV_COLOR);
+      Draw_SEG(x, Ref_Buffer[x ? x - 1 : 0], Ref_Buffer[x], REF_COLOR);
+    }
+    Popup.x = MIN_X + rand() % (X_SIZE - 40);
+    Popup.y = MIN_Y + rand() % (Y_SIZE - 40);
+    Popup.width = 40 + rand() % (MAX_X + 2 - Popup.x - 40);
+    Popup.height = 40 + rand() % (MAX_Y + 2 - Popup.y - 40);
+    Popup.Active = 1;
+    Fill_Rectangle(Popup.x, Popup.y, Popup.width, Popup.height, rand());
+    for (x = rand() % 6; x; x--) Wave();
+    memcpy(Start, Gram, sizeof(Gram));
+    Old_Hide();
+    memcpy(Old, Gram, sizeof(Gram));
+    memcpy(Gram, Start, sizeof(Gram));
+    Hide();
+    // outside the popup the former redraw also restacks wave and reference
+    for (y = 0; y < LCD_HEIGHT; y++)
+      for (x = 0; x < LCD_WIDTH; x++)
+        if (((int)x >= Popup.x) && ((int)x < Popup.x + Popup.width) && ((int)y >= Popup.y) && ((int)y < Popup.y + Popup.height))
+          n += Gram[y][x] != Old[y][x];
+        else
+          n += Gram[y][x] != Start[y][x];
+  }
+  printf("t_grid: %u popups closed, %u pixels differ from the former full redraw inside, from before outside\n", trial, n);
+  bad += n;
+
+  printf("t_grid: %u failures\n", bad);
+  return bad != 0;
+}
+/********************************* END OF FILE ********************************/
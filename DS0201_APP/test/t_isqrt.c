@@ -0,0 +1,106 @@
+/*******************************************************************************
+ File name  : t_isqrt.c
+ Description : host check of sqrt32, sqrt64 and Magnitude against the exact
+               floor of the root: every square and its neighbours, a sweep
+               over the 32 bit range (all of it with -x), random 64 bit
+               values and their edges. -b times sqrt32 against the bit by
+               bit loop it replaced
+ *******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "Calculate.h"
+
+// the former sqrt32, one result bit a step
+static unsigned short Bit_Sqrt(unsigned long n)
+{
+  unsigned short c = 0x8000, g = 0x8000;
+
+  for (;;) {
+    if ((unsigned int)g * g > n) g ^= c;
+    c >>= 1;
+    if (c == 0) return g;
+    g |= c;
+  }
+}
+
+static int Wrong32(unsigned int n)
+{
+  unsigned long long r = sqrt32(n);
+
+  return (r * r > n) || ((r + 1) * (r + 1) <= n);
+}
+
+static int Wrong64(unsigned long long n)
+{
+  unsigned long long r = sqrt64(n);
+
+  return (r * r > n) || ((r < 0xffffffffULL) && ((r + 1) * (r + 1) <= n));
+}
+
+static unsigned long long Rand64(void)
+{
+  return ((unsigned long long)rand() << 62) ^ ((unsigned long long)rand() << 31) ^ rand();
+}
+
+static int Bench(void)
+{
+  volatile unsigned int s = 0;
+  unsigned int i, n = 0;
+  double t1, t2;
+  clock_t c;
+
+  c = clock();
+  for (i = 1; i < 200000000; i += 7, n++) s += sqrt32(i * 19u);
+  t1 = (double)(clock() - c) / CLOCKS_PER_SEC / n;
+  c = clock();
+  for (i = 1; i < 200000000; i += 7) s += Bit_Sqrt(i * 19u);
+  t2 = (double)(clock() - c) / CLOCKS_PER_SEC / n;
+  printf("t_isqrt: sqrt32 %.2f ns, bit by bit %.2f ns a call\n", t1 * 1e9, t2 * 1e9);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  static const unsigned long long Edge[] = {~0ULL, 1ULL << 32, (1ULL << 32) - 1, 0xfffffffe00000001ULL, 0xfffffffe00000000ULL, 0, 1};
+  unsigned long long n, v;
+  unsigned int k, step = 997, bad32 = 0, bad64 = 0, badm = 0;
+  int i, x, y;
+
+  if ((argc > 1) && !strcmp(argv[1], "-b")) return Bench();
+  if ((argc > 1) && !strcmp(argv[1], "-x")) step = 1;
+
+  for (k = 0; k < 65536; k++) {
+    n = (unsigned long long)k * k;
+    bad32 += Wrong32(n);
+    if (k) bad32 += Wrong32(n - 1);
+    if (n < 0xffffffffULL) bad32 += Wrong32(n + 1);
+  }
+  for (n = 0; n <= 0xffffffffULL; n += step) bad32 += Wrong32(n);
+  bad32 += Wrong32(0xffffffffU);
+
+  srand(38);
+  for (i = 0; i < 2000000; i++) {
+    v = Rand64() >> (rand() % 64);
+    bad64 += Wrong64(v);
+  }
+  for (i = 0; i < (int)(sizeof(Edge) / sizeof(Edge[0])); i++) bad64 += Wrong64(Edge[i]);
+
+  for (i = 0; i < 2000000; i++) {
+    x = rand() % 65536 - 32768;
+    y = rand() % 65536 - 32768;
+    if ((rand() & 7) == 0) x = -32768;
+#if MAG_EXACT
+    badm += Magnitude(x, y) != (unsigned int)floor(hypot(x, y));
+#else
+    badm += (hypot(x, y) > 1024) && (fabs(Magnitude(x, y) - hypot(x, y)) > 0.041 * hypot(x, y));
+#endif
+  }
+
+  printf("t_isqrt: sqrt32 over %s %u wrong, sqrt64 %u wrong, Magnitude %u wrong, %u failures\n",
+         (step == 1) ? "all 2^32 inputs" : "squares and a sweep", bad32, bad64, badm, bad32 + bad64 + badm);
+  return (bad32 + bad64 + badm) != 0;
+}
+/********************************* END OF FILE ********************************/
@@ -0,0 +1,134 @@
+/*******************************************************************************
+ File name  : t_kernels.c
+ Description : host check of the sample run kernels against plain loops, at
+               every alignment and run length of the record and Sum_Squares
+               with t inside, above and below the 12 bit range, up to the
+               longest run. With -b it times them instead, Sum_Squares also
+               on longer runs, build with SAMPLE_SWAR=0 for the scalar path
+ *******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "Calculate.h"
+
+#define RECORD 3072
+#define LONGEST 65535   // the longest run an unsigned short count takes
+
+static unsigned short Buf[LONGEST + 2];
+
+static int Check(const unsigned short *p, unsigned short n, unsigned int t)
+{
+  unsigned int s = 0, a = 0, b = 7, c = 0, i;
+  unsigned long long q = 0;
+  unsigned short lo = 0xffff, hi = 0, l = 0xffff, h = 0;
+  int d, f = 0;
+
+  for (i = 0; i < n; i++) {
+    s += p[i];
+    if (p[i] < lo) lo = p[i];
+    if (p[i] > hi) hi = p[i];
+    c += p[i] < t;
+    d = p[i] - t;
+    q += (long long)d * d;
+    a += (d < 0) ? -d : d;
+  }
+  MinMax_Samples(p, n, &l, &h);
+  if (Sum_Samples(p, n) != s) f |= 1;
+  if ((l != lo) || (h != hi)) f |= 2;
+  if (Count_Below(p, n, t) != c) f |= 4;
+  if ((Sum_Squares(p, n, t, &b) != q) || (b != a + 7)) f |= 8;
+  return f;
+}
+
+static double Seconds(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void Bench(void)
+{
+  static const unsigned short Sizes[] = {RECORD, 8192, 16384, LONGEST};
+  unsigned short l, h, m;
+  unsigned int a, s = 0, r, n = 20000;
+  double t[4], w[2];
+  int k, i;
+
+  for (k = 0; k < 4; k++) {
+    t[k] = Seconds();
+    for (r = 0; r < n; r++) {
+      Buf[r & 1] ^= 1;  // keep the loop from being hoisted
+      switch (k) {
+      case 0: s += Sum_Samples(Buf + 1, RECORD); break;
+      case 1: l = 0xffff; h = 0; MinMax_Samples(Buf + 1, RECORD, &l, &h); s += l + h; break;
+      case 2: s += Count_Below(Buf + 1, RECORD, 2048); break;
+      case 3: a = 0; s += Sum_Squares(Buf + 1, RECORD, 2048, &a) + a; break;
+      }
+    }
+    t[k] = (Seconds() - t[k]) * 1e9 / ((double)n * RECORD);
+  }
+  printf("SAMPLE_SWAR %d, ns per sample: sum %.3f, min/max %.3f, count below %.3f, squares %.3f (%u)\n",
+         SAMPLE_SWAR, t[0], t[1], t[2], t[3], s & 1);
+
+  // the squares on longer runs, with t inside and beyond the 12 bit range
+  for (k = 0; k < 4; k++) {
+    m = Sizes[k];
+    for (i = 0; i < 2; i++) {
+      w[i] = Seconds();
+      for (r = 0; r < n * RECORD / m; r++) {
+        Buf[r & 1] ^= 1;
+        a = 0;
+        s += Sum_Squares(Buf + 1, m, i ? 5000 : 2048, &a) + a;
+      }
+      w[i] = (Seconds() - w[i]) * 1e9 / ((double)r * m);
+    }
+    printf("SAMPLE_SWAR %d, squares of %5u samples: ns per sample %.3f, t beyond 4095 %.3f (%u)\n",
+           SAMPLE_SWAR, m, w[0], w[1], s & 1);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  unsigned int i, o, n, t, a, b, fails = 0, runs = 0;
+  unsigned long long q;
+  int d;
+
+  srand(31);
+  for (i = 0; i < LONGEST + 2; i++) Buf[i] = rand() & 0xfff;
+  if ((argc > 1) && !strcmp(argv[1], "-b")) {
+    Bench();
+    return 0;
+  }
+  Buf[5] = 0; Buf[6] = 0xfff;  // both extremes next to each other
+  for (o = 0; o < 2; o++)
+    for (n = 0; n <= RECORD; n += (n < 40) ? 1 : 37) {
+      i = Check(Buf + o, n, (n * 7919) % 0x1001);
+      runs++;
+      if (i) {
+        if (fails++ < 10) printf("offset %u n %u: kernels 0x%x differ\n", o, n, i);
+      }
+    }
+  // Sum_Squares with t beyond either end, as Measure_Wave may pass it, and
+  // on runs past RECORD where the 64 bit total carries many blocks
+  for (o = 0; o < 2; o++)
+    for (n = 1; n <= LONGEST; n += (n < 600) ? 97 : 6911) {
+      t = (n & 1) ? 4096 + (n * 7919) % 5000 : -(int)((n * 7919) % 5000) - 1;
+      q = 0;
+      a = 0;
+      for (i = 0; i < n; i++) {
+        d = Buf[o + i] - (int)t;
+        q += (long long)d * d;
+        a += (d < 0) ? -d : d;
+      }
+      b = 7;
+      runs++;
+      if ((Sum_Squares(Buf + o, n, t, &b) != q) || (b != a + 7)) {
+        if (fails++ < 10) printf("offset %u n %u t %d: Sum_Squares differs\n", o, n, (int)t);
+      }
+    }
+  printf("t_kernels (SAMPLE_SWAR %d): %u runs, %u failures\n", SAMPLE_SWAR, runs, fails);
+  return fails != 0;
+}
@@ -0,0 +1,245 @@
+/*******************************************************************************
+ File name  : t_measure.c
+ Description : host check of the fused measure pass: Measure_Wave against
+               one pass per measure over the same records, as the code was
+               before the passes were fused, bit for bit. Sines, squares,
+               ramps and noise at random thresholds, trigger positions,
+               timebases and T1/T2 gates. -b times both
+ *******************************************************************************/
+#include <time.h>
+#include "host.h"
+#include "../source/Function.c"
+
+typedef struct {
+  unsigned char  MeFr;
+  int            Frequency, Duty, Vrms, Vavg, Period, Vpp, Vdc, Vmin, Vmax;
+  unsigned short Hist[64];
+  unsigned int   HSum[64];
+} ResultType;
+
+static unsigned short S(unsigned short i)   // trigger order index i
+{
+  return Scan_Buffer[(i + tp_to_abs) % BUFFER_SIZE];
+}
+
+// the measures of the record, each from its own pass
+static void Ref_Measure(ResultType *r)
+{
+  unsigned short i, u, v, g1 = 0, g2 = BUFFER_SIZE, t_max = 0xffff, t_min = 0, Trig = 0;
+  unsigned short Edge = 0, First_Edge = 0, Last_Edge = 0, e;
+  unsigned int Th0 = SigToAdc(Item_Index[V0]), Th1 = SigToAdc(Item_Index[VT] - Item_Index[TRIG_SENSITIVITY]);
+  unsigned int Th2 = SigToAdc(Item_Index[VT] + Item_Index[TRIG_SENSITIVITY]), Th3 = SigToAdc(Item_Index[VT]);
+  unsigned int Sq = 0, Vk = 0, n;
+  unsigned long long Sn = 0, St = 0, Set = 0, Tp;
+  int t, Sh = 0, First_T = 0, Last_T = 0, First_H = 0, Last_H = 0, Vm = 0, d, Tmp1, Tmp2;
+
+  memset(r, 0, sizeof(*r));
+  if (Item_Index[MEASURE_GATE]) {
+    t = Column_Pos(Item_Index[T1] - MIN_X);
+    g1 = (t < 0) ? 0 : (t > BUFFER_SIZE - 2) ? BUFFER_SIZE - 2 : t;
+    t = Column_Pos(Item_Index[T2] - MIN_X) + 1;
+    g2 = (t < g1 + 2) ? g1 + 2 : (t > BUFFER_SIZE) ? BUFFER_SIZE : t;
+  }
+
+  // average
+  for (i = g1; i < g2; i++) Vk += S(i);
+  Vk /= g2 - g1;
+
+  // extremes, of the displayed samples or the gate
+  for (i = g1; i < g2; i++) {
+    if (S(i) < t_max) t_max = S(i);
+    if (S(i) > t_min) t_min = S(i);
+  }
+  if (!Item_Index[MEASURE_GATE])
+    for (t_max = 0xffff, t_min = 0, i = t0; (i < t0 + 300) && (i < BUFFER_SIZE); i++) {
+      if (S(i) < t_max) t_max = S(i);
+      if (S(i) > t_min) t_min = S(i);
+    }
+
+  // histogram of the pulse levels
+  for (i = g1; i < g2; i++) {
+    r->Hist[S(i) >> 6]++;
+    r->HSum[S(i) >> 6] += S(i);
+  }
+
+  // edges, interpolated at Threshold2
+  for (i = g1; i < g2; i++) {
+    u = S((i > g1) ? i - 1 : i);
+    v = S(i);
+    if ((Trig == 0) && (v > Th1)) Trig = 1;
+    if ((Trig == 1) && (v < Th2)) {
+      Trig = 0;
+      t = (i - 1) * 256 + (u - Th2) * 256 / (u - v);
+      if (First_Edge == 0) {
+        First_Edge = Last_Edge = i;
+        Edge = 0;
+        St = Set = 0;
+        First_T = t;
+      } else {
+        Last_Edge = i;
+        Edge++;
+      }
+      St += t;
+      Set += (unsigned long long)Edge * t;
+      Last_T = t;
+    }
+  }
+
+  r->MeFr = Edge != 0;
+  if (Edge) {
+    // time below Threshold3 between the samples, at the first and last edge
+    for (i = g1; i <= Last_Edge; i++) {
+      u = S((i > g1) ? i - 1 : i);
+      v = S(i);
+      if ((v < Th3) != (u < Th3))
+        Sh += (u < Th3) ? (int)((Th3 - u) * 256 / (v - u)) - 256 : 256 - (int)((u - Th3) * 256 / (u - v));
+      if (i == First_Edge) First_H = Sh - (i * 256 - First_T);
+      if (i == Last_Edge) Last_H = Sh - (i * 256 - Last_T);
+    }
+
+    // duty count, squares and rectified sum over whole cycles
+    for (i = First_Edge; i < Last_Edge; i++) if (S(i) < Th3) Vm++;
+    for (i = First_Edge; i < Last_Edge; i++) {
+      d = S(i) - (int)Th0;
+      Sn += (long long)d * d;
+      Sq += (d < 0) ? -d : d;
+    }
+
+    e = Last_Edge - First_Edge;
+    n = Edge + 1;
+    Tp = ((2 * Set - (unsigned long long)Edge * St) * 6 * 256) / ((unsigned long long)n * (n * n - 1));
+    r->Frequency = (72000000000ULL * 65536) / (Tp * (Scan_PSC[Item_Index[X_SENSITIVITY]] + 1)
+                                                   * (Scan_ARR[Item_Index[X_SENSITIVITY]] + 1));
+    r->Duty = (100000LL * (Vm * 256 + Last_H - First_H)) / (Last_T - First_T);
+    r->Vrms = ((unsigned long long)Km[Item_Index[Y_SENSITIVITY]] * sqrt64((Sn << 16) / e)
+               * V_Scale[Item_Index[Y_SENSITIVITY]]) >> 20;
+    r->Vrms = r->Vrms + r->Vrms * (Item_Index[CALIBRATE_RANGE] - 100) / 200;
+    r->Vavg = ((unsigned long long)Km[Item_Index[Y_SENSITIVITY]] * Sq
+               * V_Scale[Item_Index[Y_SENSITIVITY]]) / ((unsigned int)e * 4096);
+    r->Vavg = r->Vavg + r->Vavg * (Item_Index[CALIBRATE_RANGE] - 100) / 200;
+    r->Period = Sample_ns(Tp, 16);
+  } else
+    r->Period = NO_MEASURE;
+
+  if (t_min < t_max) t_min = t_max;
+  Tmp1 = AdcToSig(t_min);
+  r->Vmin = (Tmp1 - Item_Index[V0]) * V_Scale[Item_Index[Y_SENSITIVITY]];
+  Tmp2 = AdcToSig(t_max);
+  r->Vmax = (Tmp2 - Item_Index[V0]) * V_Scale[Item_Index[Y_SENSITIVITY]];
+  r->Vpp = (Tmp2 - Tmp1) * V_Scale[Item_Index[Y_SENSITIVITY]];
+  r->Vdc = (AdcToSig(Vk) - Item_Index[V0]) * V_Scale[Item_Index[Y_SENSITIVITY]];
+}
+
+static void Got(ResultType *r)
+{
+  memset(r, 0, sizeof(*r));
+  r->MeFr = MeFr;
+  if (MeFr) {
+    r->Frequency = Frequency;
+    r->Duty = Duty;
+    r->Vrms = Vrms;
+    r->Vavg = Vavg;
+  }
+  r->Period = Period;
+  r->Vpp = Vpp;
+  r->Vdc = Vdc;
+  r->Vmin = Vmin;
+  r->Vmax = Vmax;
+}
+
+static double Frand(void) { return rand() / (RAND_MAX + 1.0); }
+
+// one of the signal kinds at random settings
+static void Fill(int kind)
+{
+  double per = 8 + Frand() * 600, a = 200 + Frand() * 1900, c = 600 + Frand() * 2900, ph = Frand() * per, x, y;
+  int i, noise = rand() % 3;
+
+  for (i = 0; i < BUFFER_SIZE; i++) {
+    x = fmod(i + ph, per) / per;
+    switch (kind) {
+    case 0:  y = c + a * sin(2 * M_PI * x); break;
+    case 1:  y = c + ((x < 0.3) ? a : -a); break;
+    case 2:  y = c + a * (2 * x - 1); break;
+    default: y = c + a * (Frand() * 2 - 1); break;
+    }
+    y += noise * (Frand() - 0.5) * 8;
+    Scan_Buffer[(i + tp_to_abs) % BUFFER_SIZE] = (y < 0) ? 0 : (y > 4095) ? 4095 : lrint(y);
+  }
+}
+
+static void Settings(void)
+{
+  Item_Index[X_SENSITIVITY] = rand() % 22;
+  Item_Index[Y_SENSITIVITY] = rand() % 10;
+  Item_Index[V0] = 20 + rand() % 160;
+  Item_Index[VT] = 20 + rand() % 160;
+  Item_Index[TRIG_SENSITIVITY] = rand() % 20;
+  Item_Index[CALIBRATE_RANGE] = 90 + rand() % 21;
+  Item_Index[MEASURE_GATE] = rand() & 1;
+  Item_Index[T1] = MIN_X + rand() % 300;
+  Item_Index[T2] = MIN_X + rand() % 300;
+  tp_to_abs = rand() % BUFFER_SIZE;
+  t0 = rand() % BUFFER_SIZE;
+}
+
+static double Now(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static int Bench(void)
+{
+  int k, reps = 20000;
+  double t1, t2;
+  ResultType r;
+
+  srand(30);
+  Settings();
+  Item_Index[MEASURE_GATE] = 0;
+  Fill(0);
+  t1 = Now();
+  for (k = 0; k < reps; k++) Measure_Wave();
+  t1 = (Now() - t1) / reps;
+  t2 = Now();
+  for (k = 0; k < reps; k++) Ref_Measure(&r);
+  t2 = (Now() - t2) / reps;
+  printf("t_measure: Measure_Wave %.2f us, one pass per measure %.2f us\n", t1 * 1e6, t2 * 1e6);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  ResultType a, b;
+  int trial, fails = 0, edges = 0;
+
+  Item_Index[SYNC_MODE] = 2;          // SING, no auto range
+  Item_Index[FFT_HARM] = FFT_VIEW_OFF;
+  Item_Index[CALIBRATE_OFFSET] = 100;
+  if ((argc > 1) && !strcmp(argv[1], "-b")) return Bench();
+
+  srand(30);
+  for (trial = 0; trial < 40000; trial++) {
+    Settings();
+    Fill(trial & 3);
+    Measure_Wave();
+    Got(&b);
+    memcpy(b.Hist, Scratch.Pulse.Hist, sizeof(b.Hist));
+    memcpy(b.HSum, Scratch.Pulse.HSum, sizeof(b.HSum));
+    Ref_Measure(&a);
+    edges += a.MeFr;
+    if (memcmp(&a, &b, sizeof(a))) {
+      if (fails < 10)
+        printf("t_measure: trial %d kind %d differs: freq %d %d duty %d %d rms %d %d avg %d %d period %d %d vpp %d %d vdc %d %d\n",
+               trial, trial & 3, a.Frequency, b.Frequency, a.Duty, b.Duty, a.Vrms, b.Vrms, a.Vavg, b.Vavg,
+               a.Period, b.Period, a.Vpp, b.Vpp, a.Vdc, b.Vdc);
+      fails++;
+    }
+  }
+  printf("t_measure: %d records, %d with edges, %d failures\n", trial, edges, fails);
+  return fails != 0;
+}
+/********************************* END OF FILE ********************************/
@@ -0,0 +1,115 @@
+/*******************************************************************************
+ File name  : t_peak.c
+ Description : host check of the FFT peak readout: tones swept across the
+               band at every window, size and timebase, the interpolated
+               peak of FFT_Peak within 0.1 bin and the frequency shown
+               within 0.1 bin and half its last digit. -b times FFT_Peak
+               against the whole bin search it refines
+ *******************************************************************************/
+#include <time.h>
+#include "host.h"
+#include "../source/Function.c"
+
+static double Fs(int tb)
+{
+  return 72e6 / ((Scan_PSC[tb] + 1.0) * (Scan_ARR[tb] + 1));
+}
+
+// a tone of kf bins of an n point FFT, from t0
+static void Fill(double kf, int n)
+{
+  int i;
+
+  for (i = 0; i < BUFFER_SIZE; i++)
+    Scan_Buffer[(i + t0) % BUFFER_SIZE] = lround(2048 + 1500 * cos(2 * M_PI * kf * i / n + 0.3));
+}
+
+// the readout in Hz, and half its last digit to *half
+static double Shown(double *half)
+{
+  const char *s = Host_Text[6], *d = strchr(s, '.');
+  double u = strstr(s, "MHz") ? 1e6 : strstr(s, "kHz") ? 1e3 : strstr(s, "mHz") ? 1e-3 : 1;
+  int k = 0;
+
+  if (d)
+    for (d++; (*d >= '0') && (*d <= '9'); d++) k++;
+  *half = 0.5 * pow(10, -k) * u;
+  return strtod(s, NULL) * u;
+}
+
+static double Now(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static volatile unsigned int Sink;   // keeps the whole bin searches
+
+static int Bench(void)
+{
+  int sz, n, i, k, b, reps = 20000;
+  unsigned int s = 0;
+  double t1, t2;
+
+  Item_Index[FFT_WINDOW] = 1;
+  for (sz = 0; sz < N_FFT_SIZE; sz++) {
+    n = FFT_Size[sz];
+    Item_Index[FFT_SIZE] = sz;
+    Fill(n / 5.3, n);
+    FFT_Window();
+    FFT_Finish();
+    t1 = Now();
+    for (k = 0; k < reps; k++) s += FFT_Peak(2, n / 2 - 2);
+    t1 = (Now() - t1) / reps;
+    t2 = Now();
+    for (k = 0; k < reps; k++) {
+      for (b = 2, i = 3; i <= n / 2 - 2; i++)
+        if (FFT_mag[i] > FFT_mag[b]) b = i;
+      s += b << 16;
+    }
+    t2 = (Now() - t2) / reps;
+    Sink = s;
+    printf("t_peak: %3d bins, interpolated peak %.2f us, whole bin %.2f us\n", n / 2, t1 * 1e6, t2 * 1e6);
+  }
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  int w, sz, tb, n, cases, fails = 0;
+  double kf, e, worst, wshown, got, half;
+
+  t0 = 700;   // the record wraps inside the larger FFT
+  if ((argc > 1) && !strcmp(argv[1], "-b")) return Bench();
+  for (w = 0; w < N_FFT_WINDOW; w++) {
+    worst = wshown = 0;
+    cases = 0;
+    Item_Index[FFT_WINDOW] = w;
+    for (sz = 0; sz < N_FFT_SIZE; sz++) {
+      n = FFT_Size[sz];
+      Item_Index[FFT_SIZE] = sz;
+      for (tb = 0; tb < 22; tb++) {
+        Item_Index[X_SENSITIVITY] = tb;
+        for (kf = 6.0; kf < n / 2 - 6; kf += (n / 2 - 12) / 37.0, cases++) {
+          Fill(kf, n);
+          FFT_Window();
+          FFT_Finish();
+          e = fabs(FFT_Peak(2, n / 2 - 2) / 65536.0 - kf);
+          if (e > worst) worst = e;
+          got = Shown(&half);
+          e = fabs(got - kf * Fs(tb) / n) - half;
+          e = (e > 0) ? e * n / Fs(tb) : 0;
+          if (e > wshown) wshown = e;
+        }
+      }
+    }
+    printf("t_peak: window %d, %d tones, worst peak error %.4f bin, readout %.4f bin beyond half its last digit\n",
+           w, cases, worst, wshown);
+    if ((worst > 0.1) || (wshown > 0.1)) fails++;
+  }
+  printf("t_peak: %d failures\n", fails);
+  return fails != 0;
+}
+/********************************* END OF FILE ********************************/
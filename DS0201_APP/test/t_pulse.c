@@ -0,0 +1,103 @@
+/*******************************************************************************
+ File name  : t_pulse.c
+ Description : host check of the pulse measures on single captures of
+               trapezoid pulse trains with overshoot, preshoot and noise.
+               Every record is measured once, as a SING capture is, and
+               each follows a different signal
+ *******************************************************************************/
+#include "host.h"
+#include "../source/Function.c"
+
+typedef struct { double base, top, per, r, f, hi, ph, os, ps, noise; } SigType;
+
+static double Frand(void) { return rand() / (RAND_MAX + 1.0); }
+
+// ADC value at sample t, the signal high is the low ADC value
+static double Sig(const SigType *g, double t)
+{
+  double x = fmod(t - g->ph + 100 * g->per, g->per), a = g->base - g->top, y, d;
+  double flat = g->hi - g->r / 2 - g->f / 2;   // the width at 50% is hi
+
+  if (x < g->r) return g->base - a * x / g->r;
+  if (x < g->r + flat) {
+    y = g->top;
+    d = x - g->r;
+    if (d < 8) y -= g->os * a * ((d < 2) ? d / 2 : (d < 6) ? 1 : (8 - d) / 2);
+    return y;
+  }
+  if (x < g->r + flat + g->f) return g->top + a * (x - g->r - flat) / g->f;
+  y = g->base;
+  d = x - g->r - flat - g->f;
+  if (d < 8) y += g->ps * a * ((d < 2) ? d / 2 : (d < 6) ? 1 : (8 - d) / 2);
+  return y;
+}
+
+int main(void)
+{
+  static const char *Name[6] = {"rise", "fall", "+width", "-width", "overshoot", "preshoot"};
+  double worst[6] = {0}, ns, want[6], tol, e, y;
+  int trial, i, k, x, got[6], fails = 0;
+  SigType g;
+
+  srand(34);
+  Item_Index[SYNC_MODE] = 2;          // SING, no auto range
+  Item_Index[FFT_HARM] = FFT_VIEW_OFF;
+  Item_Index[Y_SENSITIVITY] = 3;
+  Item_Index[CALIBRATE_OFFSET] = Item_Index[CALIBRATE_RANGE] = 100;
+  Item_Index[V0] = 100;
+  Item_Index[VT] = 120;
+  Item_Index[TRIG_SENSITIVITY] = 3;
+  for (trial = 0; trial < 2000; trial++) {
+    g.top = 300 + Frand() * 900;
+    g.base = 2900 + Frand() * 900;
+    g.r = 5 + Frand() * 40;
+    g.f = 5 + Frand() * 40;
+    g.per = g.r + g.f + 60 + Frand() * 500;
+    g.hi = (g.r + g.f) / 2 + 30 + Frand() * (g.per - g.r - g.f - 60);
+    g.ph = Frand() * g.per;
+    g.os = Frand() * 0.2;
+    g.ps = Frand() * 0.2;
+    if (g.top - g.os * (g.base - g.top) < 0) g.os = g.top / (g.base - g.top);
+    if (g.base + g.ps * (g.base - g.top) > 4095) g.ps = (4095 - g.base) / (g.base - g.top);
+    g.noise = (trial & 1) ? 4 : 0;
+    x = rand() % 22;
+    Item_Index[X_SENSITIVITY] = x;
+    tp_to_abs = rand() % BUFFER_SIZE;
+    for (i = 0; i < BUFFER_SIZE; i++) {
+      y = Sig(&g, i) + (g.noise ? (Frand() - 0.5) * 2 * g.noise : 0);
+      Scan_Buffer[(i + tp_to_abs) % BUFFER_SIZE] = (y < 0) ? 0 : (y > 4095) ? 4095 : lrint(y);
+    }
+    Measure_Wave();
+
+    ns = (Scan_PSC[x] + 1) * (Scan_ARR[x] + 1) * 1000.0 / 72;
+    want[0] = 0.8 * g.r * ns;
+    want[1] = 0.8 * g.f * ns;
+    want[2] = g.hi * ns;
+    want[3] = (g.per - g.hi) * ns;
+    want[4] = g.os * 100000;
+    want[5] = g.ps * 100000;
+    got[0] = Rise; got[1] = Fall; got[2] = PWidth; got[3] = NWidth;
+    got[4] = Overshoot; got[5] = Preshoot;
+    for (k = 0; k < 6; k++) {
+      if (want[k] > 2e9) continue;   // beyond the int range of the readout
+      if (k < 4) {
+        tol = (g.noise ? 0.02 : 0.005) * want[k] + 0.25 * ns + 1;
+        if (g.noise && (((k == 0) && (g.r < 4)) || ((k == 1) && (g.f < 4)))) tol *= 4;
+      } else
+        tol = 600;   // 1/1000 %, levels of bumps a few samples long
+      e = fabs(got[k] - want[k]);
+      if (k < 4) e /= want[k];
+      else e /= 1000;
+      if (e > worst[k]) worst[k] = e;
+      if ((got[k] == NO_MEASURE) || (fabs(got[k] - want[k]) > tol)) {
+        if (fails++ < 10)
+          printf("trial %d %s: got %d, want %.0f (r %.1f f %.1f per %.1f noise %g)\n",
+                 trial, Name[k], got[k], want[k], g.r, g.f, g.per, g.noise);
+      }
+    }
+  }
+  printf("t_pulse: %d single captures, worst relative error rise %.2g fall %.2g +width %.2g -width %.2g,"
+         " overshoot %.2g%% preshoot %.2g%%, %d failures\n",
+         trial, worst[0], worst[1], worst[2], worst[3], worst[4], worst[5], fails);
+  return fails != 0;
+}
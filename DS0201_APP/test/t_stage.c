@@ -0,0 +1,156 @@
+/*******************************************************************************
+ File name  : t_stage.c
+ Description : host check of the staged FFT frame: in every view the frame
+               Measure_Wave hands to FFT_Window draws the same bars and
+               readouts when the next capture overwrites Scan_Buffer before
+               the FFT_Step passes run. -b times, per view, Measure_Wave up
+               to the ADC restart and FFT_Window within it, the FFT_Step
+               passes after it and the longest of them, each the best of
+               300 frames
+ *******************************************************************************/
+#include <time.h>
+#include "host.h"
+#include "../source/Function.c"
+
+typedef struct {
+  const char    *Name;
+  unsigned char Harm, Zoom, Size;   // Item_Index[FFT_HARM], [FFT_ZOOM], [FFT_SIZE]
+} ViewType;
+
+static const ViewType Views[] = {
+  {"FFT 128",   0,             0, 0},
+  {"FFT 512",   0,             0, 1},
+  {"FFT 2048",  0,             0, 2},
+  {"harmonics", FFT_VIEW_HARM, 0, 2},
+  {"zoom x2",   0,             1, 1},
+  {"zoom x4",   0,             2, 1},
+  {"zoom x8",   0,             3, 1},
+  {"zoom x16",  0,             4, 1},
+  {"tones",     FFT_VIEW_TONE, 0, 1},
+  {"off",       FFT_VIEW_OFF,  0, 1},
+};
+#define N_VIEWS (sizeof(Views) / sizeof(Views[0]))
+
+// what a frame leaves on screen
+typedef struct {
+  unsigned char Bar[FFT_COLS];
+  char          Text[32];
+  int           Thd, ThdN, Vtone;
+} ShotType;
+
+// a 1 kHz square-ish wave with some noise, in trigger order from tp_to_abs
+static void Fill(int seed)
+{
+  int i;
+  double v, t;
+
+  srand(seed);
+  for (i = 0; i < BUFFER_SIZE; i++) {
+    t = 2 * M_PI * 1000 * i / 12500.0;
+    v = 2048 + 137 + 900 * sin(t) + 150 * sin(3 * t + 0.4) + 60 * sin(5 * t + 1.1) + (rand() % 21 - 10);
+    Scan_Buffer[(i + tp_to_abs) % BUFFER_SIZE] = (v < 0) ? 0 : (v > 4095) ? 4095 : lround(v);
+  }
+}
+
+static void Shot(ShotType *s)
+{
+  memcpy(s->Bar, FFT_Bar, sizeof(s->Bar));
+  memcpy(s->Text, Host_Text[6], sizeof(s->Text));
+  s->Thd = Thd;
+  s->ThdN = ThdN;
+  s->Vtone = Vtone;
+}
+
+static int View(const ViewType *v)
+{
+  if (v->Size >= N_FFT_SIZE) return 0;
+  Item_Index[FFT_HARM] = v->Harm;
+  Item_Index[FFT_ZOOM] = v->Zoom;
+  Item_Index[FFT_SIZE] = v->Size;
+  return 1;
+}
+
+static double Now(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static int Bench(void)
+{
+  unsigned int i, k, passes, reps = 300;
+  double t, tm, tw, ts, tl, m, w, s, l, pass;
+
+  for (i = 0; i < N_VIEWS; i++) {
+    if (!View(&Views[i])) continue;
+    Fill(1);
+    tm = tw = ts = tl = 1;
+    for (k = 0; k < reps; k++) {   // the best of reps frames, free of the host's interrupts
+      t = Now();
+      Measure_Wave();
+      m = Now() - t;
+      FFT_Finish();
+      t = Now();
+      FFT_Window();   // the part of Measure_Wave the view sets
+      w = Now() - t;
+      for (passes = 0, s = l = 0; FFT_Job.Stage != FFT_IDLE; passes++) {
+        t = Now();
+        FFT_Step();
+        pass = Now() - t;
+        s += pass;
+        if (pass > l) l = pass;
+      }
+      if (m < tm) tm = m;
+      if (w < tw) tw = w;
+      if (s < ts) ts = s;
+      if (l < tl) tl = l;
+    }
+    printf("t_stage: %-9s Measure_Wave %6.1f us to the ADC restart, FFT_Window %6.1f us of it,"
+           " then %d passes of %6.1f us, longest %6.1f us\n",
+           Views[i].Name, tm * 1e6, tw * 1e6, passes, ts * 1e6, tl * 1e6);
+  }
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  ShotType a, b;
+  unsigned int i, j, fails = 0;
+
+  Item_Index[SYNC_MODE] = 2;          // SING, no auto range
+  Item_Index[Y_SENSITIVITY] = 3;
+  Item_Index[X_SENSITIVITY] = 10;
+  Item_Index[CALIBRATE_OFFSET] = Item_Index[CALIBRATE_RANGE] = 100;
+  Item_Index[V0] = 100;
+  Item_Index[VT] = 120;
+  Item_Index[FFT_WINDOW] = 1;
+  Item_Index[FFT_CENTER] = 700;
+  Item_Index[TONE_SET] = N_TONE_SET - 1;
+  tp_to_abs = 1000;
+  t0 = 2200;   // the record wraps inside the largest FFT
+  if ((argc > 1) && !strcmp(argv[1], "-b")) return Bench();
+
+  for (i = 0; i < N_VIEWS; i++) {
+    if (!View(&Views[i])) continue;
+    Fill(1);
+    Measure_Wave();
+    FFT_Finish();
+    Shot(&a);
+
+    // again, with the next capture landing before the stages run
+    Fill(1);
+    Measure_Wave();
+    for (j = 0; j < BUFFER_SIZE; j++) Scan_Buffer[j] = (j * 2654435761u) >> 20;
+    FFT_Finish();
+    Shot(&b);
+    if (memcmp(&a, &b, sizeof(a))) {
+      printf("t_stage: %s reads the record after FFT_Window\n", Views[i].Name);
+      fails++;
+    }
+  }
+  printf("t_stage: %u views, %u failures\n", (unsigned)N_VIEWS, fails);
+  return fails != 0;
+}
+/********************************* END OF FILE ********************************/
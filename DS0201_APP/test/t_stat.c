@@ -0,0 +1,234 @@
+/*******************************************************************************
+ File name  : t_stat.c
+ Description : host check of the measure statistics: Stat_Update at every
+               window against the same exponentially weighted Welford update
+               in double, with values missing from some records, a level
+               step and the count saturating, and the statistics sector of
+               SaveStat against both. Includes Menu.c for SaveStat, so it
+               brings the stubs of the LCD and SD card itself. -b times
+               Stat_Update per record of all kinds
+ *******************************************************************************/
+#include <time.h>
+#include "host.h"
+#include "../source/Function.c"
+#include "../source/Menu.c"
+
+volatile u32 Host_Update[64];
+volatile unsigned short Refresh_Counter, Measure_Counter;
+unsigned int File_Size;
+
+void ADC_Start(void) {}
+void ADC_Stop(void) {}
+void NVIC_SETPRIMASK(void) {}
+void NVIC_RESETPRIMASK(void) {}
+void Display_Grid(void) {}
+void Display_Grid_Area(short x0, short y0, short width, short height) {}
+void Display_Str(short x0, short y0, short Color, char Mode, unsigned const char *s) {}
+void Fill_Rectangle(short x0, short y0, short width, short height, short Color) {}
+void Rounded_Rectangle(short x0, short y0, short width, short height, short Color) {}
+void Draw_SEG(unsigned short x, unsigned short y1, unsigned short y2, unsigned short Color) {}
+void Erase_SEG(unsigned short x, unsigned short y1, unsigned short y2, unsigned short Color) {}
+void Popup_SEG(unsigned short x, unsigned short y1, unsigned short y2, unsigned short Color) {}
+void Draw_Ti_Line(unsigned short Ti, char Mode, unsigned short Color) {}
+void Draw_Ti_Mark(unsigned short Ti, char Mode, unsigned short Color) {}
+void Draw_Vi_Line(unsigned short Vi, char Mode, unsigned short Color) {}
+void Draw_Vi_Mark(unsigned short Vi, char Mode, unsigned short Color) {}
+void Draw_Vt_Line(unsigned short Vt, char Mode, unsigned short Color) {}
+void Draw_Trig_Pos(void) {}
+void Erase_Trig_Pos(void) {}
+void Set_Base(char Base) {}
+void Set_Range(char Range) {}
+void Set_Y_Pos(unsigned short i, unsigned short Y0) {}
+void cr4_fft_64_stm32(void *pssOUT, void *pssIN, u16 Nbin) {}
+void cr4_fft_256_stm32(void *pssOUT, void *pssIN, u16 Nbin) {}
+char SD_Card_ON(void) { return 1; }
+char FAT_Info(void) { return 0; }
+char Open_File(unsigned const char *name, unsigned char *num, unsigned const char *ext) { return 0; }
+char Read_File(void) { return 0; }
+char Writ_BMP_File(void) { return 0; }
+void Read_Parameter(void) {}
+char Write_Parameter(void) { return 0; }
+
+static unsigned char Sector[512];   // the last sector written
+static int Sectors;
+
+char Next_Sector(void) { return 0; }
+char Write_File(void)
+{
+  memcpy(Sector, F_Buff, sizeof(Sector));
+  Sectors++;
+  return 0;
+}
+
+#define RECORDS 70000   // past the saturation of Count
+#define STEP    30000   // the record of the level step
+
+// the value of each measure kind as Measure_Value reads it
+static int *const Value[N_MEASURE] = {&Frequency, &Duty, &Vrms, &Vavg, &Vpp, &Vdc, &Vmin, &Vmax,
+  &Vtone, &Rise, &Fall, &PWidth, &NWidth, &Period, &Overshoot, &Preshoot, &Thd, &ThdN, &Rate};
+
+// level, gaussian spread and step of each kind, deviations stay below the
+// variance clamp of 2^27 units; Vavg is constant, its variance stays 0
+static const int Level[N_MEASURE] = {500000000, 50000, 1200, 800, 3000, -150, -1700, 1500,
+  400, 35, 40, 250000, 250000, 500000, 2500, 1800, 1200, 3400, 40000000};
+static const int Spread[N_MEASURE] = {10000000, 300, 3, 0, 40, 2, 25, 25,
+  1, 1, 1, 5000, 5000, 10, 400, 300, 30, 60, 1000000};
+
+// the update in double, with the weight of Stat_Update
+typedef struct {
+  double Mean, Var;
+  int    Min, Max;
+  unsigned int Count;
+} RefType;
+
+static RefType Ref[N_MEASURE];
+
+static void Ref_Update(RefType *r, int v, unsigned short w)
+{
+  unsigned int n;
+  double d;
+
+  if (r->Count < 0xffff) r->Count++;
+  if ((r->Count == 1) || (v < r->Min)) r->Min = v;
+  if ((r->Count == 1) || (v > r->Max)) r->Max = v;
+  n = ((w != 0) && (r->Count > w)) ? w : r->Count;
+  d = v - r->Mean;
+  r->Mean += d / n;
+  r->Var += (d * (v - r->Mean) - r->Var) / n;
+}
+
+static double Gauss(void)
+{
+  double u = (rand() + 1.0) / (RAND_MAX + 2.0), v = rand() / (RAND_MAX + 1.0);
+
+  return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+// the values of record i, NO_MEASURE or a cleared flag for the missing ones
+static void Record(int i, unsigned char *given)
+{
+  int k;
+
+  MeFr = (rand() % 10) != 0;
+  MeDC = (rand() % 10) != 0;
+  for (k = 0; k < N_MEASURE; k++) {
+    *Value[k] = lround(Level[k] + Spread[k] * (Gauss() + ((i >= STEP) ? 3 : 0)));
+    given[k] = (k < 4) ? MeFr : (k < 8) ? MeDC : ((rand() % 10) != 0);
+    if (!given[k]) *Value[k] = NO_MEASURE;
+  }
+}
+
+static int Get_Int(const unsigned char *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static double Now(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static int Bench(void)
+{
+  unsigned char given[N_MEASURE];
+  int w, i, reps = 20000;
+  double t, best;
+
+  for (w = 0; w < N_STAT_WINDOW; w++) {
+    Item_Index[MEASURE_STATS] = w;
+    Stat_Reset();
+    srand(w);
+    Record(0, given);
+    for (best = 1, i = 0; i < reps; i++) {
+      t = Now();
+      Stat_Update();
+      t = Now() - t;
+      if (t < best) best = t;
+    }
+    printf("t_stat: window %3d, Stat_Update %.3f us per record of %d kinds\n", Stat_Window[w], best * 1e6, N_MEASURE);
+  }
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned char given[N_MEASURE], *p;
+  int w, i, k, fails = 0, bad;
+  unsigned short win;
+  double em, ev, e, m, v, all[N_MEASURE][2];
+  RefType first[N_MEASURE];
+
+  if ((argc > 1) && !strcmp(argv[1], "-b")) return Bench();
+  for (w = 0; w < N_STAT_WINDOW; w++) {
+    win = Stat_Window[w];
+    Item_Index[MEASURE_STATS] = w;
+    Stat_Reset();
+    memset(Ref, 0, sizeof(Ref));
+    memset(all, 0, sizeof(all));
+    srand(17 + w);
+    em = ev = 0;
+    bad = 0;
+    for (i = 0; i < RECORDS; i++) {
+      Record(i, given);
+      Stat_Update();
+      for (k = 0; k < N_MEASURE; k++) {
+        if (!given[k]) continue;
+        Ref_Update(&Ref[k], *Value[k], win);
+        if (Ref[k].Count < 0xffff) {   // plain sums while the weight is 1/n
+          all[k][0] += *Value[k] - Level[k];
+          all[k][1] += (double)(*Value[k] - Level[k]) * (*Value[k] - Level[k]);
+          first[k] = Ref[k];
+        }
+        if ((Stat[k].Count != Ref[k].Count) || (Stat[k].Min != Ref[k].Min) || (Stat[k].Max != Ref[k].Max))
+          bad++;
+
+        // in LSB of Mean and Var, the variance beyond 1e-8 of itself for the
+        // deviations cut to 32 bit for the product, a few 2^-31 each. Both
+        // stay within a few LSB, the remainders carry what n truncates
+        e = fabs(Stat[k].Mean - Ref[k].Mean * 65536);
+        if (e > em) em = e;
+        e = fabs(Stat[k].Var - Ref[k].Var * 256) - 1e-8 * Ref[k].Var * 256;
+        if (e > ev) ev = e;
+      }
+    }
+    printf("t_stat: window %3d, worst mean error %.2f LSB of 1/65536, variance %.2f LSB of 1/256\n", win, em, ev);
+    if (bad) printf("t_stat: window %3d, %d records with count, min or max off\n", win, bad);
+    if (bad || (em > 2) || (ev > 3)) fails++;
+
+    // since reset the update gives the population mean and variance, up to
+    // the 65534th value where the count saturates
+    if (win == 0)
+      for (k = 0; k < N_MEASURE; k++) {
+        m = all[k][0] / first[k].Count;
+        v = all[k][1] / first[k].Count - m * m;
+        if ((fabs(first[k].Mean - Level[k] - m) > 1e-14 * abs(Level[k]) + 1e-6) || (fabs(first[k].Var - v) > 1e-9 * v + 1e-6)) {
+          printf("t_stat: kind %d, the double update leaves the population mean and variance\n", k);
+          fails++;
+        }
+      }
+
+    // the sector as the file gets it
+    Sectors = 0;
+    if ((SaveStat() != 0) || (Sectors != 1) || (Sector[0] != 'S') || (Sector[1] != 'T') ||
+        ((Sector[2] | (Sector[3] << 8)) != win) || (Sector[4] != N_MEASURE)) {
+      printf("t_stat: window %3d, the statistics sector header is off\n", win);
+      fails++;
+      continue;
+    }
+    for (p = Sector + 6, k = 0; k < N_MEASURE; k++, p += 20) {
+      if ((Get_Int(p) != Stat[k].Count) || (Get_Int(p + 12) != Ref[k].Min) || (Get_Int(p + 16) != Ref[k].Max) ||
+          (abs(Get_Int(p + 4) - (int)lround(Ref[k].Mean)) > 1) || (abs(Get_Int(p + 8) - (int)lround(sqrt(Ref[k].Var))) > 1)) {
+        printf("t_stat: window %3d kind %d, sector %d %d %d %d %d against %u %.1f %.1f %d %d\n", win, k,
+               Get_Int(p), Get_Int(p + 4), Get_Int(p + 8), Get_Int(p + 12), Get_Int(p + 16),
+               Ref[k].Count, Ref[k].Mean, sqrt(Ref[k].Var), Ref[k].Min, Ref[k].Max);
+        fails++;
+      }
+    }
+  }
+  printf("t_stat: %d windows, %d failures\n", N_STAT_WINDOW, fails);
+  return fails != 0;
+}
+/********************************* END OF FILE ********************************/
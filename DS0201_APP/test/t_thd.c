@@ -0,0 +1,190 @@
+/*******************************************************************************
+ File name  : t_thd.c
+ Description : host check of the harmonic analysis: signals of known
+               harmonic content and white noise at each size and window,
+               THD and THD+N against the values the input implies, the
+               windows that give no value, and the bar heights of
+               Harm_Amp. -b times FFT_Harmonics against the same sums in
+               double
+ *******************************************************************************/
+#include <time.h>
+#include "host.h"
+#include "../source/Function.c"
+
+static double A[N_HARM + 1], Ph[N_HARM + 1], F1, A1, Sig;
+
+static double Gauss(void)
+{
+  double u = (rand() + 1.0) / (RAND_MAX + 2.0), v = rand() / (RAND_MAX + 1.0);
+
+  return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+// the fundamental F1 bins of an n point FFT at A1, harmonics A[k], noise Sig
+// rms, from t0
+static void Fill(int n)
+{
+  int i, k;
+  double v;
+
+  for (i = 0; i < BUFFER_SIZE; i++) {
+    v = 2048 + 137 + A1 * cos(2 * M_PI * F1 * i / n + 0.7);
+    for (k = 2; k <= N_HARM; k++) v += A[k] * cos(2 * M_PI * k * F1 * i / n + Ph[k]);
+    v += Sig * Gauss();
+    Scan_Buffer[(i + t0) % BUFFER_SIZE] = (v < 0) ? 0 : (v > 4095) ? 4095 : lround(v);
+  }
+}
+
+// lobe half width of window w as FFT_Harmonics takes it
+static int Lobe(int w)
+{
+  int s;
+
+  for (s = 1; (s < 5) && Win_Coef[w][s]; s++);
+  return s;
+}
+
+// THD and THD+N of the frame in FFT_mag in double, in 1/1000 %
+static void Ref_Harmonics(int n, unsigned int peak, double *thd, double *thdn)
+{
+  int s = Lobe(Item_Index[FFT_WINDOW]), t = Harm_Notch[Item_Index[FFT_WINDOW]], b1 = (peak + 32768) >> 16, k, b, i;
+  double p1 = 0, ph = 0, pn = 0, p;
+
+  for (i = b1 - s; i <= b1 + s; i++) p1 += (double)FFT_mag[i] * FFT_mag[i];
+  for (k = 2; k <= N_HARM; k++) {
+    b = (k * peak + 32768) >> 16;
+    if (b + s >= n / 2) break;
+    for (p = 0, i = b - s; i <= b + s; i++) p += (double)FFT_mag[i] * FFT_mag[i];
+    ph += p;
+  }
+  for (b = t + 1; b < n / 2; b++)
+    if (abs(b - b1) > t) pn += (double)FFT_mag[b] * FFT_mag[b];
+  *thd = 100000 * sqrt(ph / p1);
+  *thdn = 100000 * sqrt(pn / p1);
+}
+
+static double Now(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static volatile double Sink;   // keeps the reference sums
+
+static int Bench(void)
+{
+  int sz, n, k, reps = 20000;
+  unsigned int peak;
+  double t1, t2, a, b, s = 0;
+
+  Item_Index[FFT_WINDOW] = 3;
+  for (sz = 0; sz < N_FFT_SIZE; sz++) {
+    n = FFT_Size[sz];
+    Item_Index[FFT_SIZE] = sz;
+    F1 = (n < 256) ? 12.3 : 21.7; A1 = 1500; A[2] = 30; A[3] = 10; Sig = 1;
+    Fill(n);
+    FFT_Window();
+    FFT_Finish();
+    peak = FFT_Peak(2, n / 2 - 2);
+    t1 = Now();
+    for (k = 0; k < reps; k++) FFT_Harmonics(n, peak);
+    t1 = (Now() - t1) / reps;
+    t2 = Now();
+    for (k = 0; k < reps; k++) {
+      Ref_Harmonics(n, peak, &a, &b);
+      s += a + b;
+    }
+    t2 = (Now() - t2) / reps;
+    Sink = s;
+    printf("t_thd: %3d bins, FFT_Harmonics %.2f us, double %.2f us\n", n / 2, t1 * 1e6, t2 * 1e6);
+  }
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  int sz, w, trial, n, k, s, t, b1, nl, valid, want_t, want_n, fails = 0;
+  double sh, allh, frac, f1b, exp_thd, exp_thdn, et, en, fl, wt, wn, wa, bar, wbar = 0;
+
+  t0 = 2900;   // the record wraps inside the larger FFT
+  Item_Index[X_SENSITIVITY] = 10;
+  if ((argc > 1) && !strcmp(argv[1], "-b")) return Bench();
+  for (sz = 0; sz < N_FFT_SIZE; sz++)
+    for (w = 0; w < N_FFT_WINDOW; w++) {
+      n = FFT_Size[sz];
+      s = Lobe(w);
+      t = Harm_Notch[w];
+      wt = wn = wa = 0;
+      valid = 0;
+      Item_Index[FFT_SIZE] = sz;
+      Item_Index[FFT_WINDOW] = w;
+      for (trial = 0; trial < 40; trial++) {
+        srand(trial * 31 + w * 7 + sz * 1000);
+        Sig = (trial % 3) * 0.75;
+        A1 = 800 + rand() % 900;
+        // odd trials keep more harmonics below the Nyquist frequency
+        F1 = 12 + (rand() / (double)RAND_MAX) * ((trial & 1) ? n / 8.0 - 12 : n / 20.0 - 12);
+        if (n < 256) F1 = 11 + (rand() / (double)RAND_MAX) * 4;
+        for (sh = allh = 0, k = 2; k <= N_HARM; k++) {
+          A[k] = ((rand() % 3 == 0) || (k * F1 + 6 >= n / 2)) ? 0 : A1 * pow(10, -(20 + rand() % 40) / 20.0);
+          Ph[k] = rand();
+          if (k * F1 + 6 < n / 2) sh += A[k] * A[k];
+          if (k * F1 < n / 2) allh += A[k] * A[k];
+        }
+        Fill(n);
+        FFT_Window();
+        FFT_Finish();
+
+        // THD counts the noise inside the harmonic lobes, THD+N the white
+        // noise and quantization outside the DC and fundamental notches
+        f1b = floor(F1 * 65536) / 65536;
+        for (nl = 0, k = 2; k <= N_HARM; k++)
+          if (floor(k * f1b + 0.5) + s < n / 2) nl++;
+        frac = 1 - (double)(4 * t + 2) / (n / 2);
+        exp_thd = 100 * sqrt(sh + nl * (2 * s + 1) * 2 * (Sig * Sig + 1.0 / 12) / (n / 2)) / A1;
+        exp_thdn = 100 * sqrt(allh + 2 * (Sig * Sig + 1.0 / 12) * frac) / A1;
+
+        // Rect and Hamming give neither, THD+N needs the notch inside the band
+        b1 = lround(F1);
+        want_t = t != 0;
+        want_n = t && (b1 > 2 * t) && (b1 + t < n / 2);
+        if (((Thd >= 0) != want_t) || ((ThdN >= 0) != want_n)) {
+          printf("n %d window %d trial %d: THD %d THD+N %d, want %s %s (f1 %.2f)\n", n, w, trial, Thd, ThdN,
+                 want_t ? "a value" : "none", want_n ? "a value" : "none", F1);
+          fails++;
+          continue;
+        }
+
+        if (!want_t) continue;
+
+        // the bars, the harmonics against the fundamental to a few LSB
+        if (Sig == 0)
+          for (k = 2; k <= N_HARM; k++) {
+            if (k * F1 + s >= n / 2) break;
+            bar = fabs(Harm_Amp[k - 1] - A[k] * Harm_Amp[0] / A1);
+            if (bar > wbar) wbar = bar;
+          }
+
+        // the relative error beyond the floor of the integer bin magnitudes,
+        // higher for Hann, whose skirt rounds up, and for the small FFT
+        et = fabs(Thd / 1000.0 - exp_thd);
+        en = want_n ? fabs(ThdN / 1000.0 - exp_thdn) : 0;
+        fl = (n < 256) ? 0.25 : (w == 1) ? 0.12 : 0.07;
+        if ((et - fl) / exp_thd > wt) wt = (et - fl) / exp_thd;
+        if ((en - fl) / exp_thdn > wn) wn = (en - fl) / exp_thdn;
+        if ((exp_thd > 1) && (et / exp_thd > wa)) wa = et / exp_thd;
+        if (want_n && (exp_thdn > 1) && (en / exp_thdn > wa)) wa = en / exp_thdn;
+        valid++;
+      }
+      printf("t_thd: %3d points, window %d, %2d signals, beyond the floor THD %.3f THD+N %.3f relative, above 1%% %.4f\n",
+             n, w, valid, wt, wn, wa);
+      if ((wt > 0.1) || (wn > 0.2)) fails++;
+    }
+  printf("t_thd: worst bar %.2f LSB under the windows that give THD\n", wbar);
+  if (wbar > 3) fails++;
+  printf("t_thd: %d failures\n", fails);
+  return fails != 0;
+}
+/********************************* END OF FILE ********************************/
@@ -0,0 +1,236 @@
+/*******************************************************************************
+ File name  : t_tone.c
+ Description : host check of the Goertzel tone detector: levels of known
+               tones under each window, leakage into the other tones of the
+               set, tones out of the band, the picked tone Vtone gives, and
+               the record taken in trigger order across the buffer wrap,
+               and the same levels when the next capture overwrites
+               Scan_Buffer while the resonators run. -b times the
+               resonators against a floating point Goertzel, and what
+               FFT_Window blocks against the longest FFT_Step pass
+ *******************************************************************************/
+#include <time.h>
+#include "host.h"
+#include "../source/Function.c"
+
+static unsigned short Ref[BUFFER_SIZE];   // the record while Scan_Buffer is overwritten
+static unsigned int Rms[N_TONE];
+
+static double Fs(void)
+{
+  return 72e6 / ((Scan_PSC[Item_Index[X_SENSITIVITY]] + 1.0) * (Scan_ARR[Item_Index[X_SENSITIVITY]] + 1));
+}
+
+// n tones of frequency f and amplitude a around mid scale, square waves if sq,
+// in trigger order from Scan_Buffer[tp_to_abs], plus a little fixed noise
+static void Fill(const double *f, const double *a, int n, int sq)
+{
+  int i, k;
+  double v;
+
+  for (i = 0; i < BUFFER_SIZE; i++) {
+    for (v = 2048, k = 0; k < n; k++)
+      v += sq ? ((sin(2 * M_PI * f[k] * i / Fs()) >= 0) ? a[k] : -a[k])
+              : a[k] * cos(2 * M_PI * f[k] * i / Fs() + k);
+    v += (i * 7919 % 41) - 20;
+    Scan_Buffer[(i + tp_to_abs) % BUFFER_SIZE] = (v < 0) ? 0 : (v > 4095) ? 4095 : lround(v);
+  }
+}
+
+static void Frame(void)
+{
+  FFT_Window();
+  FFT_Finish();
+}
+
+// Vtone of a tone of amplitude a, as Vrms takes ADC steps to uV
+static double Want_uV(double a)
+{
+  return a / sqrt(2) * Km[Item_Index[Y_SENSITIVITY]] * V_Scale[Item_Index[Y_SENSITIVITY]] / 4096;
+}
+
+// |X| of a floating point Goertzel under the same window, in the units of
+// the resonators: the window takes the samples in at 1/8 on average
+static double Ref_Goertzel(double f, int w)
+{
+  double s1 = 0, s2 = 0, s, c = 2 * cos(2 * M_PI * f / Fs()), m = 0, x;
+  int i;
+
+  for (i = 0; i < BUFFER_SIZE; i++) m += Scan_Buffer[(i + tp_to_abs) % BUFFER_SIZE];
+  m = floor(m / BUFFER_SIZE + 0.5);
+  for (i = 0; i < BUFFER_SIZE; i++) {
+    x = (Scan_Buffer[(i + tp_to_abs) % BUFFER_SIZE] - m) * Window(Win_Coef[w], i * FFT_PHASE / BUFFER_SIZE) / 131072.0;
+    s = x + c * s1 - s2;
+    s2 = s1;
+    s1 = s;
+  }
+  return sqrt(s1 * s1 + s2 * s2 - c * s1 * s2);
+}
+
+static volatile double Sink;   // keeps the reference runs
+
+static double Now(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static int Bench(void)
+{
+  double f[2] = {697, 1209}, a[2] = {500, 300}, t1, t2, r = 0, tw = 0, ts = 0, tl, t;
+  int i, k, n = 2000;
+  clock_t c;
+
+  Item_Index[FFT_WINDOW] = 1;
+  Item_Index[TONE_SET] = 2;
+  Fill(f, a, 2, 0);
+  c = clock();
+  for (i = 0; i < n; i++) Frame();
+  t1 = (double)(clock() - c) / CLOCKS_PER_SEC / n;
+  c = clock();
+  for (i = 0; i < n; i++)
+    for (k = 0; k < N_TONE; k++) r += Ref_Goertzel(Tone_Hz[2][k], 1);
+  t2 = (double)(clock() - c) / CLOCKS_PER_SEC / n;
+  Sink = r;
+  printf("t_tone: %d samples x %d tones, fixed point %.1f us, double %.1f us a record\n",
+         BUFFER_SIZE, N_TONE, t1 * 1e6, t2 * 1e6);
+
+  // the part that holds the ADC restart, and the longest pass after it
+  for (i = 0; i < n; i++) {
+    t = Now();
+    FFT_Window();
+    tw += Now() - t;
+    for (tl = 0; FFT_Job.Stage != FFT_IDLE; ) {
+      t = Now();
+      FFT_Step();
+      t = Now() - t;
+      if (t > tl) tl = t;
+    }
+    ts += tl;
+  }
+  printf("t_tone: FFT_Window %.1f us before the ADC restarts, longest FFT_Step pass %.1f us, mean of %d frames\n",
+         tw / n * 1e6, ts / n * 1e6, n);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  double f[3], a[3], want, e, worst = 0;
+  int fails = 0, i, k, w;
+
+  Item_Index[X_SENSITIVITY] = 10;
+  Item_Index[Y_SENSITIVITY] = 3;
+  Item_Index[FFT_HARM] = FFT_VIEW_TONE;
+  Item_Index[CALIBRATE_RANGE] = 100;
+  if ((argc > 1) && !strcmp(argv[1], "-b")) return Bench();
+
+  // DTMF 697 + 1209 Hz under each window, levels and leakage into the set
+  for (w = 0; w < N_FFT_WINDOW; w++) {
+    f[0] = 697; f[1] = 1209; a[0] = 500; a[1] = 300;
+    Item_Index[FFT_WINDOW] = w;
+    Item_Index[TONE_SET] = 2;
+    Item_Index[TONE_PICK] = 0;
+    tp_to_abs = (w * 997) % BUFFER_SIZE;   // the record wraps anywhere
+    Fill(f, a, 2, 0);
+    Frame();
+    for (k = 0; k < N_TONE; k++) {
+      want = (k == 0) ? 500 / sqrt(2) * 256 : (k == 4) ? 300 / sqrt(2) * 256 : 0;
+      e = fabs(Tone[k].Rms - want);
+      if (e > (want ? want * 0.01 : 0.02 * 500 / sqrt(2) * 256)) {
+        printf("window %d, DTMF tone %d: rms %u, want %.0f\n", w, k, Tone[k].Rms, want);
+        fails++;
+      }
+      // against the floating point resonator, 1/256 ADC step rms per |X| / (BUFFER_SIZE / 16 sqrt(2))
+      want = Ref_Goertzel(Tone_Hz[2][k], w) * 16 / BUFFER_SIZE / sqrt(2) * 256;
+      e = fabs(Tone[k].Rms - want) / (500 / sqrt(2) * 256);
+      if (e > worst) worst = e;
+      if (e > 0.001) {
+        printf("window %d, DTMF tone %d: rms %u, double Goertzel %.0f\n", w, k, Tone[k].Rms, want);
+        fails++;
+      }
+    }
+    if (fabs(Vtone - Want_uV(500)) > 0.01 * Want_uV(500)) {
+      printf("window %d: Vtone %d uV, want %.0f\n", w, Vtone, Want_uV(500));
+      fails++;
+    }
+  }
+
+  // the next capture refills Scan_Buffer while the resonators run
+  for (k = 0; k < N_TONE; k++) Rms[k] = Tone[k].Rms;
+  memcpy(Ref, (void *)Scan_Buffer, sizeof(Ref));
+  FFT_Window();
+  for (i = 0; i < BUFFER_SIZE; i++) Scan_Buffer[i] = (i * 2654435761u) >> 20;
+  FFT_Finish();
+  for (k = 0, i = 0; k < N_TONE; k++) i += Tone[k].Rms != Rms[k];
+  memcpy((void *)Scan_Buffer, Ref, sizeof(Ref));
+  if (i) {
+    printf("capture during the resonators: %d tones changed\n", i);
+    fails++;
+  }
+
+  // the picked tone, 1209 Hz is tone 5 of the DTMF set, 1336 Hz is not there
+  Item_Index[TONE_PICK] = 5;
+  Frame();
+  if (fabs(Vtone - Want_uV(300)) > 0.01 * Want_uV(300) || strncmp(Host_Text[6], "1.209", 5)) {
+    printf("Tone Lvl 5: Vtone %d uV, want %.0f, readout '%s'\n", Vtone, Want_uV(300), Host_Text[6]);
+    fails++;
+  }
+  Item_Index[TONE_PICK] = 6;
+  Frame();
+  if (Vtone > 0.02 * Want_uV(500)) {
+    printf("Tone Lvl 6: Vtone %d uV of an absent tone\n", Vtone);
+    fails++;
+  }
+
+  // 50 Hz hum and odd harmonics
+  Item_Index[FFT_WINDOW] = 1;
+  Item_Index[TONE_SET] = 0;
+  Item_Index[TONE_PICK] = 0;
+  f[0] = 50; f[1] = 150; f[2] = 250; a[0] = 800; a[1] = 200; a[2] = 100;
+  Fill(f, a, 3, 0);
+  Frame();
+  if (fabs(Tone[0].Rms / 256.0 - 800 / sqrt(2)) > 6 || fabs(Tone[2].Rms / 256.0 - 200 / sqrt(2)) > 2
+      || fabs(Tone[4].Rms / 256.0 - 100 / sqrt(2)) > 2 || Tone[1].Rms > 512) {
+    printf("hum: %u %u %u %u %u\n", Tone[0].Rms, Tone[1].Rms, Tone[2].Rms, Tone[3].Rms, Tone[4].Rms);
+    fails++;
+  }
+
+  // a slow timebase puts the DTMF tones above half the sample rate
+  Item_Index[X_SENSITIVITY] = 16;
+  Item_Index[TONE_SET] = 2;
+  Frame();
+  for (k = 0, i = 0; k < N_TONE; k++) i += Tone[k].W != 0;
+  if (i || Vtone != NO_MEASURE) {
+    printf("out of band: %d tones, Vtone %d\n", i, Vtone);
+    fails++;
+  }
+  Item_Index[TONE_PICK] = 1;
+  Frame();
+  if (Vtone != NO_MEASURE) {
+    printf("out of band, Tone Lvl 1: Vtone %d\n", Vtone);
+    fails++;
+  }
+
+  // full scale square wave into a tone 2 bins up, and its third harmonic
+  Item_Index[X_SENSITIVITY] = 10;
+  Item_Index[TONE_SET] = 3;
+  Item_Index[TONE_PICK] = 0;
+  Item_Index[FFT_WINDOW] = 0;
+  Item_Index[FFT_CENTER] = (unsigned)ceil(2.0 * FFT_CENTER_FS / BUFFER_SIZE);
+  f[0] = Item_Index[FFT_CENTER] * Fs() / FFT_CENTER_FS;
+  a[0] = 2100;
+  Fill(f, a, 1, 1);
+  Frame();
+  want = 2048 * 4 / M_PI / sqrt(2) * 256;
+  if (fabs(Tone[0].Rms / want - 1) > 0.03 || fabs((double)Tone[2].Rms / Tone[0].Rms - 1 / 3.0) > 0.02) {
+    printf("square wave: tone 1 %.3f of the fundamental, tone 3 %.3f of tone 1\n",
+           Tone[0].Rms / want, (double)Tone[2].Rms / Tone[0].Rms);
+    fails++;
+  }
+
+  printf("t_tone: worst level against a double Goertzel %.4f%% of the tone, %d failures\n", 100 * worst, fails);
+  return fails != 0;
+}
+/********************************* END OF FILE ********************************/
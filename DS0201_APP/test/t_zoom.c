@@ -0,0 +1,231 @@
+/*******************************************************************************
+ File name  : t_zoom.c
+ Description : host check of the zoom FFT at every zoom and window: peak
+               readout, gain on bin centers, stopband, spurs and the noise
+               floor of the view, with the FFT modelled as DFT / N. The
+               streaming mixer over its FFT_MIX passes, from the copy
+               FFT_Window takes, must give the output of a direct form FIR
+               on Scan_Buffer bit for bit; -b times the two
+ *******************************************************************************/
+#include <time.h>
+#include "host.h"
+#include "../source/Function.c"
+
+#define FS 12500.0   // X_SENSITIVITY 10: 72MHz / (16 * 360)
+
+static double Ft[4], Fa[4], Noise;
+static int Nt;
+
+// Nt tones on some DC in trigger order from Scan_Buffer[tp_to_abs]
+static void Fill(void)
+{
+  int i, k;
+  double v;
+
+  for (i = 0; i < BUFFER_SIZE; i++) {
+    v = 2048 + 137;
+    for (k = 0; k < Nt; k++) v += Fa[k] * cos(2 * M_PI * Ft[k] * i / FS + k);
+    if (Noise) v += Noise * (rand() / (double)RAND_MAX - 0.5);
+    Scan_Buffer[(i + tp_to_abs) % BUFFER_SIZE] = (v < 0) ? 0 : (v > 4095) ? 4095 : lround(v);
+  }
+}
+
+static void Frame(void)
+{
+  FFT_Window();
+  FFT_Finish();
+}
+
+static double Frand(void) { return rand() / (double)RAND_MAX; }
+
+// largest bin of the view from the first one drawn, its index to *at
+static double View_Max(int z, int *at)
+{
+  int m = FFT_Size[Zoom_Size[z]] / 2, h = (m * Zoom_Dec[z]) >> (z + 2), i, b, k;
+
+  k = Item_Index[FFT_CENTER] * m * Zoom_Dec[z] / FFT_CENTER_FS - h;
+  b = (k < 2) ? 2 - k : 0;
+  for (i = b; i < 2 * h; i++)
+    if (FFT_mag[i] > FFT_mag[b]) b = i;
+  if (at) *at = b;
+  return FFT_mag[b];
+}
+
+// the mixer with each sample mixed again for every tap, as a direct form FIR
+static void Direct_Mix(unsigned short m, unsigned char d, unsigned char g, short const *c)
+{
+  unsigned short l = (m + ZOOM_TAPS - 1) * d, o, j, n, t;
+  const volatile unsigned short *q, *p;
+  unsigned int w = Item_Index[FFT_CENTER] * (0x80000000U / (FFT_CENTER_FS / 2)), ph;
+  int s, mean, si, sq, f, u, v;
+
+  n = Linear_Run((BUFFER_SIZE - l) / 2, l, &q);
+  mean = (Sum_Samples(q, n) + Sum_Samples(Scan_Buffer, l - n) + l / 2) / l;
+  for (o = 0; o < m; o++) {
+    for (si = sq = 0, j = 0; j < ZOOM_TAPS * d; j++) {
+      t = o * d + j;
+      p = (t < n) ? q + t : Scan_Buffer + (t - n);
+      ph = t * w;
+      s = *p - mean;
+      u = (s * Cosine(ph >> 16) + 0x2000) >> 14;
+      v = (0x2000 - s * Cosine((ph >> 16) - FFT_PHASE / 4)) >> 14;
+      si += Scratch.Zoom.Coef[j] * (short)u;
+      sq += Scratch.Zoom.Coef[j] * (short)v;
+    }
+    f = Window(c, o * (FFT_PHASE / m)) >> 1;
+    ((short *)FFT_in)[2 * o] = Clamp16((((si + (0x1000 << g)) >> (13 + g)) * f + 0x2000) >> 14);
+    ((short *)FFT_in)[2 * o + 1] = Clamp16((((sq + (0x1000 << g)) >> (13 + g)) * f + 0x2000) >> 14);
+  }
+}
+
+static double Now(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// the streaming kernel against the direct form: identical output, and time
+static int Mixers(int bench)
+{
+  static int a[FFT_MAX];
+  int z, m, d, g, k, reps = bench ? 400 : 4, fails = 0;
+  double t1, t2;
+
+  Item_Index[FFT_WINDOW] = 1;
+  Nt = 1; Ft[0] = 1234; Fa[0] = 1800; Noise = 0;
+  Fill();
+  for (z = 1; z < N_FFT_ZOOM; z++) {
+    m = FFT_Size[Zoom_Size[z]] / 2;
+    d = Zoom_Dec[z];
+    Item_Index[FFT_ZOOM] = z;
+    Item_Index[FFT_CENTER] = 1000;
+    FFT_Move_Center(0);
+    t1 = Now();
+    for (k = 0; k < reps; k++) {
+      FFT_Window();   // the record copy, then the FFT_MIX passes
+      while (FFT_Job.Stage == FFT_MIX) FFT_Step();
+    }
+    t1 = (Now() - t1) / reps;
+    FFT_Job.Stage = FFT_IDLE;   // the transform would take the filter
+    g = FFT_Job.Gain;
+    memcpy(a, FFT_in, m * 4);
+    t2 = Now();
+    for (k = 0; k < reps; k++) Direct_Mix(m, d, g, Win_Coef[1]);
+    t2 = (Now() - t2) / reps;
+    if (memcmp(a, FFT_in, m * 4)) {
+      printf("x%d: streaming and direct form mixers differ\n", 1 << z);
+      fails++;
+    }
+    if (bench)
+      printf("t_zoom: x%-2d mixer %6.1f us (%.1f ns a sample), direct form %7.1f us, %.1fx\n", 1 << z,
+             t1 * 1e6, t1 * 1e9 / ((m + ZOOM_TAPS - 1) * d), t2 * 1e6, t2 / t1);
+  }
+  return fails;
+}
+
+int main(int argc, char **argv)
+{
+  int z, w, i, k, m, d, r, h, at, trial, first, fails = 0;
+  double bin, f0, f, e, g, got, werr[N_FFT_WINDOW], gmin, gmax, stop, spur, floor_;
+
+  tp_to_abs = 1000;
+  Item_Index[X_SENSITIVITY] = 10;
+  Item_Index[FFT_SIZE] = N_FFT_SIZE - 1;
+  if ((argc > 1) && !strcmp(argv[1], "-b")) return Mixers(1);
+
+  srand(47);
+  for (z = 1; z < N_FFT_ZOOM; z++) {
+    m = FFT_Size[Zoom_Size[z]] / 2;
+    d = Zoom_Dec[z];
+    r = m * d;
+    h = r >> (z + 2);
+    bin = FS / r;
+    gmin = 1e9; gmax = stop = spur = floor_ = 0;
+    Item_Index[FFT_ZOOM] = z;
+    // the record holds the filter span, the view is in the flat quarter
+    if (((m + ZOOM_TAPS - 1) * d > BUFFER_SIZE) || (4 * h > m)) {
+      printf("x%d: %d points at decimation %d do not fit\n", 1 << z, m, d);
+      fails++;
+    }
+    for (w = 0; w < N_FFT_WINDOW; w++) {
+      Item_Index[FFT_WINDOW] = w;
+      werr[w] = 0;
+      for (trial = 0; trial < 60; trial++) {
+        Item_Index[FFT_CENTER] = rand() % 4097;
+        FFT_Move_Center(0);
+        f0 = Item_Index[FFT_CENTER] * FS / FFT_CENTER_FS;
+
+        // a tone anywhere in the view, another outside the filter span
+        f = f0 + (Frand() * (2 * h - 6) - (h - 3)) * bin;
+        Nt = 2; Ft[0] = f; Fa[0] = 1500;
+        Ft[1] = Frand() * FS / 2;
+        Fa[1] = (fabs(Ft[1] - f0) > 3 * FS / (4 * d)) ? 400 : 0;
+        Noise = 4;
+        Fill();
+        Frame();
+        got = strtod(Host_Text[6], NULL) * (strstr(Host_Text[6], "kHz") ? 1000 : strstr(Host_Text[6], "mHz") ? 0.001 : 1);
+        e = fabs(got - f) / bin;
+        if (e > werr[w]) werr[w] = e;
+        if (w != 1) continue;
+
+        // Hann: gain on a bin center
+        Nt = 1; Ft[0] = f0 + (rand() % (2 * h - 4) - (h - 2)) * bin; Fa[0] = 2000; Noise = 0;
+        Fill();
+        Frame();
+        g = View_Max(z, &at) / 4000.0;
+        if (g < gmin) gmin = g;
+        if (g > gmax) gmax = g;
+
+        // stopband: a near full scale tone 3/4 of the decimated rate or more away
+        for (k = 0; k < 100; k++) {
+          Ft[0] = Frand() * FS / 2;
+          if (fabs(Ft[0] - f0) >= 3 * FS / (4 * d)) break;
+        }
+        if (k < 100) {
+          Fa[0] = 1800;
+          Fill();
+          Frame();
+          if (View_Max(z, 0) > stop) stop = View_Max(z, 0);
+        }
+
+        // spurs: a strong tone in the view, the bins more than 12 from it
+        Ft[0] = f0 + (Frand() * (2 * h - 40) - (h - 20)) * bin; Fa[0] = 1800;
+        Fill();
+        Frame();
+        View_Max(z, &at);
+        k = Item_Index[FFT_CENTER] * r / FFT_CENTER_FS - h;
+        first = (k < 2) ? 2 - k : 0;
+        for (i = first; i < 2 * h; i++)
+          if ((abs(i - at) > 12) && (FFT_mag[i] > spur)) spur = FFT_mag[i];
+
+        Nt = 0;
+        Fill();
+        Frame();
+        if (View_Max(z, 0) > floor_) floor_ = View_Max(z, 0);
+      }
+    }
+    printf("t_zoom: x%-2d %3d points, decimation %2d, bin %.3f Hz, peak error %.3f %.3f %.3f %.3f %.3f bin,"
+           " gain %.4f..%.4f, stopband %.1f, spurs %.1f, floor %.1f dBFS\n",
+           1 << z, m, d, bin, werr[0], werr[1], werr[2], werr[3], werr[4], gmin, gmax,
+           20 * log10((stop + .5) / 4096), 20 * log10((spur + .5) / 4096), 20 * log10((floor_ + .5) / 4096));
+    for (w = 0; w < N_FFT_WINDOW; w++)
+      if (werr[w] > 0.1 + 0.5 * 0.001 * 10 / bin) {   // 0.1 bin and half the last digit shown
+        printf("x%d, window %d: peak error %.3f bin\n", 1 << z, w, werr[w]);
+        fails++;
+      }
+    if ((gmin < 0.97) || (gmax > 1.03)) {
+      printf("x%d: gain %.4f..%.4f\n", 1 << z, gmin, gmax);
+      fails++;
+    }
+    if ((20 * log10((stop + .5) / 4096) > -66) || (20 * log10((spur + .5) / 4096) > -66)) {
+      printf("x%d: stopband or spurs above -66 dBFS\n", 1 << z);
+      fails++;
+    }
+  }
+  fails += Mixers(0);
+  printf("t_zoom: %d failures\n", fails);
+  return fails != 0;
+}
+/********************************* END OF FILE ********************************/